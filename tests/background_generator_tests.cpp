@@ -0,0 +1,102 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 200;
+const size_t HEIGHT = 150;
+
+// Waits for the generator to finish everything requested. Returns false on
+// timeout.
+bool waitIdle(const BackgroundGenerator& generator) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (generator.busy()) {
+		if (std::chrono::steady_clock::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+std::vector<float> directMap(const MapParams& params, ThreadPool& pool) {
+	std::vector<float> map(WIDTH * HEIGHT);
+	generateMap(map.data(), WIDTH, HEIGHT, params.octaves, params.persistence, params.lacunarity, params.seed, params.source, params.noise, pool);
+	return map;
+}
+
+std::vector<uint8_t> directPixels(const std::vector<float>& map, const Colormap* colormap = nullptr) {
+	std::vector<uint8_t> pixels(WIDTH * HEIGHT * 4);
+	mapToPixels(map.data(), WIDTH, HEIGHT, pixels.data(), WIDTH, colormap);
+	return pixels;
+}
+
+}
+
+TEST(background_generator, newest_request_wins) {
+	ThreadPool pool(2);
+	BackgroundGenerator generator(WIDTH, HEIGHT, pool);
+	MapParams params;
+	params.octaves = 6;
+	for (uint32_t seed = 0; seed < 20; seed++)
+	{
+		params.seed = seed;
+		generator.request(params);
+	}
+	CHECK(waitIdle(generator));
+
+	std::vector<float> map;
+	std::vector<uint8_t> pixels;
+	std::vector<DirtyRect> dirty;
+	CHECK(generator.takeResult(map, pixels, dirty));
+	CHECK(map == directMap(params, pool));
+	CHECK(pixels == directPixels(map));
+	CHECK(dirty.size() == 1 && dirty[0].width == WIDTH && dirty[0].height == HEIGHT);
+	CHECK(!generator.takeResult(map, pixels, dirty));
+}
+
+TEST(background_generator, dirty_rects_bring_the_map_up_to_date) {
+	ThreadPool pool(2);
+	BackgroundGenerator generator(WIDTH, HEIGHT, pool);
+	MapParams params;
+	params.octaves = 5;
+	params.seed = 3;
+	generator.request(params);
+	CHECK(waitIdle(generator));
+	std::vector<float> map;
+	std::vector<uint8_t> pixels;
+	std::vector<DirtyRect> dirty;
+	CHECK(generator.takeResult(map, pixels, dirty));
+
+	// Only the finest octave changes, through the cached layers.
+	params.persistence = 0.6f;
+	generator.request(params);
+	CHECK(waitIdle(generator));
+	CHECK(generator.takeResult(map, pixels, dirty));
+	CHECK(!dirty.empty());
+	CHECK(map == directMap(params, pool));
+	CHECK(pixels == directPixels(map));
+}
+
+TEST(background_generator, colormap_change_recolors_the_shown_map) {
+	ThreadPool pool(2);
+	BackgroundGenerator generator(WIDTH, HEIGHT, pool);
+	MapParams params;
+	params.octaves = 4;
+	generator.request(params);
+	CHECK(waitIdle(generator));
+	std::vector<float> map;
+	std::vector<uint8_t> pixels;
+	std::vector<DirtyRect> dirty;
+	CHECK(generator.takeResult(map, pixels, dirty));
+	std::vector<float> before = map;
+
+	auto colormap = std::make_shared<const Colormap>(biomeStops());
+	generator.setColormap(colormap);
+	CHECK(waitIdle(generator));
+	CHECK(generator.takeResult(map, pixels, dirty));
+	CHECK(map == before);
+	CHECK(pixels == directPixels(map, colormap.get()));
+}
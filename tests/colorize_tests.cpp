@@ -0,0 +1,81 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 203;
+const size_t HEIGHT = 150;
+// Wider than the map, so rows of pixels don't line up with rows of heights.
+const size_t P_WIDTH = 211;
+
+// fBm heights with some past both ends of [-1, 1].
+std::vector<float> testMap() {
+	ThreadPool pool(2);
+	std::vector<float> map(WIDTH * HEIGHT);
+	generateMap(map.data(), WIDTH, HEIGHT, 5, 0.5f, 2.f, 3, GradientSource::Hash, NoiseBackend::Perlin, pool);
+	for (size_t i = 0; i < map.size(); i += 7)
+	{
+		map[i] *= 4.f;
+	}
+	return map;
+}
+
+// Pixels outside the map keep this, so stray writes show.
+std::vector<uint8_t> blankPixels() {
+	return std::vector<uint8_t>(P_WIDTH * HEIGHT * 4, 0xAB);
+}
+
+}
+
+TEST(colorize, pooled_matches_serial) {
+	std::vector<float> map = testMap();
+	const Colormap colormap(biomeStops());
+	for (const Colormap* cm : { (const Colormap*)nullptr, &colormap }) {
+		std::vector<uint8_t> expected = blankPixels();
+		mapToPixels(map.data(), WIDTH, HEIGHT, expected.data(), P_WIDTH, cm);
+		for (size_t threads : { 1, 3, 8 }) {
+			ThreadPool pool(threads);
+			std::vector<uint8_t> actual = blankPixels();
+			mapToPixels(map.data(), WIDTH, HEIGHT, actual.data(), P_WIDTH, pool, cm);
+			CHECK(actual == expected);
+		}
+	}
+}
+
+TEST(colorize, rects_match_the_whole_map) {
+	std::vector<float> map = testMap();
+	const Colormap colormap(biomeStops());
+	const DirtyRect rects[] = {
+		{ 0, 0, WIDTH, HEIGHT },
+		// Touches the right and bottom edges.
+		{ 150, 100, WIDTH - 150, HEIGHT - 100 },
+		// Narrower than any SIMD vector.
+		{ 17, 9, 3, 40 },
+		{ WIDTH - 1, HEIGHT - 1, 1, 1 },
+		{ 5, 60, 9, 1 },
+	};
+	for (const Colormap* cm : { (const Colormap*)nullptr, &colormap }) {
+		std::vector<uint8_t> whole = blankPixels();
+		mapToPixels(map.data(), WIDTH, HEIGHT, whole.data(), P_WIDTH, cm);
+		for (const DirtyRect& rect : rects) {
+			std::vector<uint8_t> pixels = blankPixels();
+			mapRectToPixels(map.data(), WIDTH, rect, pixels.data(), P_WIDTH, cm);
+			bool same = true;
+			for (size_t y = 0; y < HEIGHT; y++)
+			{
+				for (size_t x = 0; x < P_WIDTH; x++)
+				{
+					bool inside = x >= rect.x && x < rect.x + rect.width && y >= rect.y && y < rect.y + rect.height;
+					for (size_t c = 0; c < 4; c++)
+					{
+						size_t i = (y * P_WIDTH + x) * 4 + c;
+						same = same && pixels[i] == (inside ? whole[i] : 0xAB);
+					}
+				}
+			}
+			CHECK(same);
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const size_t LAST = Colormap::LUT_SIZE - 1;
+
+// Height of LUT entry i, computed the way Colormap does.
+float entryHeight(size_t i) {
+	return -1.f + 2.f * i / LAST;
+}
+
+int channel(uint32_t rgba, size_t c) {
+	return (int)(rgba >> (8 * c) & 0xFF);
+}
+
+int expectedChannel(float value) {
+	return (int)(value * 255.f + 0.5f);
+}
+
+// Two stops on LUT entries 1000 and 3000, given out of order.
+std::vector<ColorStop> twoStops() {
+	return {
+		{ "high", entryHeight(3000), { 0.6f, 0.2f, 0.f } },
+		{ "low", entryHeight(1000), { 0.2f, 0.6f, 1.f } },
+	};
+}
+
+std::vector<SimdLevel> supportedLevels() {
+	std::vector<SimdLevel> levels;
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 }) {
+		if (level <= detectSimdLevel()) levels.push_back(level);
+	}
+	return levels;
+}
+
+}
+
+TEST(colormap, stops_map_to_their_color) {
+	Colormap colormap(twoStops());
+	CHECK(colormap.stops()[0].name == "low");
+	for (const ColorStop& stop : colormap.stops()) {
+		uint32_t rgba = colormap.lut()[Colormap::lutIndex(stop.height)];
+		for (size_t c = 0; c < 3; c++)
+		{
+			CHECK(channel(rgba, c) == expectedChannel(stop.color[c]));
+		}
+		CHECK(channel(rgba, 3) == 255);
+	}
+
+	// Stops between entries land within rounding of their color.
+	Colormap biome(biomeStops());
+	for (const ColorStop& stop : biome.stops()) {
+		uint32_t rgba = biome.lut()[Colormap::lutIndex(stop.height)];
+		for (size_t c = 0; c < 3; c++)
+		{
+			CHECK(std::abs(channel(rgba, c) - expectedChannel(stop.color[c])) <= 2);
+		}
+	}
+}
+
+TEST(colormap, colors_blend_linearly_between_stops) {
+	Colormap colormap(twoStops());
+	const ColorStop& low = colormap.stops()[0];
+	const ColorStop& high = colormap.stops()[1];
+	uint32_t mid = colormap.lut()[2000];
+	for (size_t c = 0; c < 3; c++)
+	{
+		CHECK(channel(mid, c) == expectedChannel((low.color[c] + high.color[c]) / 2));
+	}
+	bool linear = true;
+	for (size_t i = 1000; i <= 3000; i++)
+	{
+		float t = (i - 1000) / 2000.f;
+		for (size_t c = 0; c < 3; c++)
+		{
+			float color = low.color[c] + t * (high.color[c] - low.color[c]);
+			linear = linear && std::abs(channel(colormap.lut()[i], c) - color * 255.f) <= 0.51f;
+		}
+	}
+	CHECK(linear);
+}
+
+TEST(colormap, heights_past_the_ends_clamp) {
+	Colormap colormap(twoStops());
+	const uint32_t* lut = colormap.lut();
+	bool clamped = true;
+	for (size_t i = 0; i <= 1000; i++)
+	{
+		clamped = clamped && lut[i] == lut[1000];
+	}
+	for (size_t i = 3000; i <= LAST; i++)
+	{
+		clamped = clamped && lut[i] == lut[3000];
+	}
+	CHECK(clamped);
+	CHECK(Colormap::lutIndex(-1.f) == 0 && Colormap::lutIndex(-7.f) == 0);
+	CHECK(Colormap::lutIndex(1.f) == LAST && Colormap::lutIndex(7.f) == LAST);
+	CHECK(Colormap::lutIndex(std::numeric_limits<float>::infinity()) == LAST);
+	CHECK(Colormap::lutIndex(-std::numeric_limits<float>::infinity()) == 0);
+}
+
+TEST(colormap, nan_maps_to_entry_zero) {
+	CHECK(Colormap::lutIndex(std::nanf("")) == 0);
+	Colormap colormap(twoStops());
+	const float heights[] = { std::nanf(""), 0.f, std::nanf(""), -std::nanf(""), 0.5f, std::nanf(""), 0.f, 0.f, std::nanf("") };
+	const size_t n = sizeof(heights) / sizeof(heights[0]);
+	for (SimdLevel level : supportedLevels()) {
+		std::vector<uint32_t> pixels(n);
+		colormapKernel(level)(heights, n, colormap.lut(), (uint8_t*)pixels.data());
+		for (size_t i = 0; i < n; i++)
+		{
+			uint32_t expected = colormap.lut()[std::isnan(heights[i]) ? 0 : Colormap::lutIndex(heights[i])];
+			CHECK(pixels[i] == expected);
+		}
+	}
+}
+
+TEST(colormap, no_stops_is_opaque_black) {
+	Colormap colormap({});
+	CHECK(colormap.lut()[0] == 0xFF000000u && colormap.lut()[LAST] == 0xFF000000u);
+}
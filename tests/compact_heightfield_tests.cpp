@@ -0,0 +1,215 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 211;
+const size_t HEIGHT = 77;
+
+float fromBits(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t toBits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+// Encodes values as halves in one call, which takes the F16C path on AVX2
+// CPUs for every full group of 8.
+std::vector<uint16_t> encodeHalves(const std::vector<float>& values) {
+	CompactHeightfield field(values.size(), 1, HeightEncoding::Half);
+	field.encode(values.data(), 0, values.size());
+	return std::vector<uint16_t>(field.data(), field.data() + values.size());
+}
+
+// Encodes values one at a time, which always takes the scalar path.
+std::vector<uint16_t> encodeHalvesScalar(const std::vector<float>& values) {
+	CompactHeightfield field(values.size(), 1, HeightEncoding::Half);
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		field.encode(values.data() + i, i, 1);
+	}
+	return std::vector<uint16_t>(field.data(), field.data() + values.size());
+}
+
+uint16_t encodeHalf(float value) {
+	return encodeHalvesScalar({ value })[0];
+}
+
+}
+
+TEST(compact_heightfield, half_rounding_and_specials) {
+	const float inf = std::numeric_limits<float>::infinity();
+	// Exact values, both signs of zero and the largest finite half.
+	CHECK(encodeHalf(1.f) == 0x3C00 && encodeHalf(-2.f) == 0xC000);
+	CHECK(encodeHalf(0.f) == 0x0000 && encodeHalf(-0.f) == 0x8000);
+	CHECK(encodeHalf(65504.f) == 0x7BFF);
+	// Ties go to the even mantissa.
+	CHECK(encodeHalf(1.f + std::ldexp(1.f, -11)) == 0x3C00);
+	CHECK(encodeHalf(1.f + 3 * std::ldexp(1.f, -11)) == 0x3C02);
+	CHECK(encodeHalf(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20)) == 0x3C01);
+	// Subnormals are multiples of 2^-24, with the same ties.
+	CHECK(encodeHalf(std::ldexp(1.f, -24)) == 0x0001);
+	CHECK(encodeHalf(std::ldexp(1.f, -25)) == 0x0000);
+	CHECK(encodeHalf(3 * std::ldexp(1.f, -25)) == 0x0002);
+	CHECK(encodeHalf(std::ldexp(1.f, -14) - std::ldexp(1.f, -24)) == 0x03FF);
+	CHECK(encodeHalf(std::ldexp(1.f, -14)) == 0x0400);
+	CHECK(encodeHalf(-std::ldexp(1.f, -30)) == 0x8000);
+	// Past the largest half, from the tie with 2^16 on, is infinity.
+	CHECK(encodeHalf(65519.f) == 0x7BFF);
+	CHECK(encodeHalf(65520.f) == 0x7C00);
+	CHECK(encodeHalf(-1e9f) == 0xFC00);
+	CHECK(encodeHalf(inf) == 0x7C00 && encodeHalf(-inf) == 0xFC00);
+	uint16_t nan = encodeHalf(std::nanf(""));
+	CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x03FF) != 0);
+}
+
+TEST(compact_heightfield, vector_and_scalar_halves_match_bit_for_bit) {
+	std::vector<float> values = {
+		0.f, -0.f, 1.f, 65504.f, 65519.f, 65520.f, 1e9f, -1e9f,
+		std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+		std::ldexp(1.f, -24), std::ldexp(1.f, -25), 3 * std::ldexp(1.f, -25), std::ldexp(1.f, -14),
+		1.f + std::ldexp(1.f, -11), 1.f + 3 * std::ldexp(1.f, -11),
+	};
+	// Every tie and near-tie around a spread of exponents, then random bits.
+	for (int exponent = -27; exponent <= 16; exponent++)
+	{
+		for (uint32_t low : { 0x0FFFu, 0x1000u, 0x1001u, 0x3000u })
+		{
+			float base = std::ldexp(1.f, exponent);
+			values.push_back(fromBits(toBits(base) | low));
+			values.push_back(-fromBits(toBits(base) | 0x2000 | low));
+		}
+	}
+	// Quiet and signaling NaNs with payloads.
+	for (uint32_t bits : { 0x7FC00000u, 0xFFC00001u, 0x7F800001u, 0x7FA02000u, 0xFF9FFFFFu }) {
+		values.push_back(fromBits(bits));
+	}
+	std::mt19937 rng(3);
+	while (values.size() % 8 != 0 || values.size() < 4096) {
+		values.push_back(fromBits(rng()));
+	}
+	CHECK(encodeHalves(values) == encodeHalvesScalar(values));
+
+	// Every half decodes the same either way and encodes back to itself.
+	CompactHeightfield field(65536, 1, HeightEncoding::Half);
+	for (size_t h = 0; h < 65536; h++)
+	{
+		field.data()[h] = (uint16_t)h;
+	}
+	std::vector<float> bulk(65536);
+	field.decode(0, bulk.size(), bulk.data());
+	bool same = true;
+	bool round_trip = true;
+	for (size_t h = 0; h < 65536; h++)
+	{
+		float one;
+		field.decode(h, 1, &one);
+		same = same && toBits(one) == toBits(bulk[h]);
+		if (!std::isnan(one)) round_trip = round_trip && encodeHalf(one) == h;
+	}
+	CHECK(same);
+	CHECK(round_trip);
+}
+
+TEST(compact_heightfield, decoded_heights_stay_within_error_bound) {
+	std::mt19937 rng(11);
+	for (HeightEncoding encoding : { HeightEncoding::Uint16, HeightEncoding::Half }) {
+		for (float range : { 0.01f, 0.7071f, 1.f, 37.f }) {
+			for (float offset : { 0.f, 0.3f }) {
+				float min = -range + offset * range;
+				float max = range + offset * range;
+				std::uniform_real_distribution<float> dist(min, max);
+				std::vector<float> heights(10001);
+				for (float& h : heights) {
+					h = dist(rng);
+				}
+				heights[0] = min;
+				heights[1] = max;
+				CompactHeightfield field(heights.size(), 1, encoding, min, max);
+				field.encode(heights.data(), 0, heights.size());
+				std::vector<float> decoded(heights.size());
+				field.decode(0, decoded.size(), decoded.data());
+				float largest = 0;
+				for (size_t i = 0; i < heights.size(); i++)
+				{
+					largest = std::max(largest, std::fabs(decoded[i] - heights[i]));
+				}
+				CHECK(largest <= field.errorBound());
+				// Nor is it loose. A range ending on a power of two, where
+				// halves get further apart, is off by up to a factor of two.
+				CHECK(largest >= 0.25f * field.errorBound());
+			}
+		}
+	}
+}
+
+TEST(compact_heightfield, uint16_clamps_to_its_range) {
+	CompactHeightfield field(4, 1, HeightEncoding::Uint16, -0.5f, 0.5f);
+	const float heights[] = { -3.f, -0.5f, 0.5f, 3.f };
+	field.encode(heights, 0, 4);
+	CHECK(field.data()[0] == 0 && field.data()[1] == 0);
+	CHECK(field.data()[2] == 65535 && field.data()[3] == 65535);
+}
+
+TEST(compact_heightfield, empty_range_becomes_a_unit_range) {
+	// --persistence 0 gives every octave amplitude 0 and heightBound 0.
+	float bound = heightBound(octaveSpecs(64, 4, 0.f, 2.f, 1), NoiseBackend::Perlin);
+	CHECK(bound == 0.f);
+	CompactHeightfield field(3, 1, HeightEncoding::Uint16, -bound, bound);
+	CHECK(field.min() == 0.f && field.max() == 1.f);
+	CHECK(std::isfinite(field.errorBound()));
+	const float heights[] = { 0.f, 0.f, 0.f };
+	field.encode(heights, 0, 3);
+	float decoded[3];
+	field.decode(0, 3, decoded);
+	CHECK(decoded[0] == 0.f && decoded[1] == 0.f && decoded[2] == 0.f);
+
+	CompactHeightfield reversed(1, 1, HeightEncoding::Uint16, 2.f, -2.f);
+	CHECK(reversed.min() == 2.f && reversed.max() == 3.f);
+}
+
+TEST(compact_heightfield, generated_map_matches_generate_map) {
+	ThreadPool pool(3);
+	for (NoiseBackend noise : { NoiseBackend::Perlin, NoiseBackend::Simplex }) {
+		std::vector<float> map(WIDTH * HEIGHT);
+		generateMap(map.data(), WIDTH, HEIGHT, 6, 0.5f, 2.f, 17, GradientSource::Hash, noise, pool);
+		float bound = heightBound(octaveSpecs(WIDTH, 6, 0.5f, 2.f, 17), noise);
+		for (HeightEncoding encoding : { HeightEncoding::Uint16, HeightEncoding::Half }) {
+			CompactHeightfield expected(WIDTH, HEIGHT, encoding, -bound, bound);
+			expected.encode(map.data(), 0, map.size());
+			CompactHeightfield compact(WIDTH, HEIGHT, encoding, -bound, bound);
+			GenerationProgress progress;
+			CHECK(generateCompactMap(compact, 6, 0.5f, 2.f, 17, GradientSource::Hash, noise, pool, &progress));
+			CHECK(progress.done == progress.total);
+			CHECK(memcmp(compact.data(), expected.data(), map.size() * sizeof(uint16_t)) == 0);
+
+			std::vector<float> decoded(map.size());
+			compact.decode(0, decoded.size(), decoded.data());
+			bool close = true;
+			for (size_t i = 0; i < map.size(); i++)
+			{
+				close = close && std::fabs(decoded[i] - map[i]) <= compact.errorBound();
+			}
+			CHECK(close);
+		}
+	}
+}
+
+TEST(compact_heightfield, cancelled_generation_fails) {
+	ThreadPool pool(2);
+	CompactHeightfield compact(WIDTH, HEIGHT, HeightEncoding::Half);
+	CancellationToken cancel;
+	cancel.cancel();
+	CHECK(!generateCompactMap(compact, 6, 0.5f, 2.f, 17, GradientSource::Hash, NoiseBackend::Perlin, pool, nullptr, &cancel));
+}
@@ -0,0 +1,109 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+bool sameRect(const DirtyRect& rect, size_t x, size_t y, size_t width, size_t height) {
+	return rect.x == x && rect.y == y && rect.width == width && rect.height == height;
+}
+
+}
+
+TEST(dirty_rect, identical_maps_are_clean) {
+	std::vector<float> map(100 * 70, 0.25f);
+	CHECK(diffMaps(map.data(), map.data(), 100, 70, 16).empty());
+}
+
+TEST(dirty_rect, one_pixel_dirties_its_block) {
+	std::vector<float> before(100 * 70, 0.f);
+	std::vector<float> after = before;
+	after[40 * 100 + 37] = 1.f;
+	std::vector<DirtyRect> rects = diffMaps(before.data(), after.data(), 100, 70, 16);
+	CHECK(rects.size() == 1);
+	CHECK(sameRect(rects[0], 32, 32, 16, 16));
+}
+
+TEST(dirty_rect, neighbours_merge_within_a_row_only) {
+	std::vector<float> before(100 * 70, 0.f);
+	std::vector<float> after = before;
+	// Blocks 0 and 1 of block row 0, block 4 of block row 0, block 0 of row 1.
+	after[5] = 1.f;
+	after[20] = 1.f;
+	after[70] = 1.f;
+	after[20 * 100 + 3] = 1.f;
+	std::vector<DirtyRect> rects = diffMaps(before.data(), after.data(), 100, 70, 16);
+	CHECK(rects.size() == 3);
+	CHECK(sameRect(rects[0], 0, 0, 32, 16));
+	CHECK(sameRect(rects[1], 64, 0, 16, 16));
+	CHECK(sameRect(rects[2], 0, 16, 16, 16));
+}
+
+TEST(dirty_rect, edge_blocks_are_clipped) {
+	std::vector<float> before(100 * 70, 0.f);
+	std::vector<float> after = before;
+	after[69 * 100 + 99] = 1.f;
+	std::vector<DirtyRect> rects = diffMaps(before.data(), after.data(), 100, 70, 16);
+	CHECK(rects.size() == 1);
+	CHECK(sameRect(rects[0], 96, 64, 4, 6));
+}
+
+TEST(dirty_rect, copying_the_rects_reproduces_the_new_map) {
+	const size_t width = 203;
+	const size_t height = 117;
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<size_t> pick(0, width * height - 1);
+	for (int trial = 0; trial < 20; trial++)
+	{
+		std::vector<float> before(width * height);
+		for (size_t i = 0; i < before.size(); i++)
+		{
+			before[i] = (float)(rng() % 1000) / 1000.f;
+		}
+		std::vector<float> after = before;
+		for (int n = 0; n < trial * 3; n++)
+		{
+			after[pick(rng)] += 0.5f;
+		}
+		std::vector<DirtyRect> rects = diffMaps(before.data(), after.data(), width, height, 32);
+		size_t dirty = 0;
+		for (const DirtyRect& rect : rects)
+		{
+			CHECK(rect.x + rect.width <= width && rect.y + rect.height <= height);
+			copyRect(after.data(), before.data(), width, rect);
+			dirty += rect.width * rect.height;
+		}
+		CHECK(before == after);
+		CHECK(trial > 0 || dirty == 0);
+	}
+}
+
+TEST(dirty_rect, extract_packs_rgba_rows) {
+	const size_t width = 9;
+	const size_t height = 6;
+	std::vector<uint8_t> pixels(width * height * 4);
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		pixels[i] = (uint8_t)i;
+	}
+	DirtyRect rect = { 2, 1, 5, 3 };
+	std::vector<uint8_t> out(rect.width * rect.height * 4);
+	extractRect(pixels.data(), width, rect, out.data());
+	bool same = true;
+	for (size_t y = 0; y < rect.height; y++)
+	{
+		for (size_t x = 0; x < rect.width * 4; x++)
+		{
+			same = same && out[y * rect.width * 4 + x] == pixels[((rect.y + y) * width + rect.x) * 4 + x];
+		}
+	}
+	CHECK(same);
+
+	std::vector<uint8_t> copy(pixels.size(), 0);
+	copyRect(pixels.data(), copy.data(), width, rect, 4);
+	CHECK(copy[(1 * width + 2) * 4] == pixels[(1 * width + 2) * 4]);
+	CHECK(copy[(3 * width + 6) * 4 + 3] == pixels[(3 * width + 6) * 4 + 3]);
+	CHECK(copy[(4 * width + 2) * 4 + 1] == 0 && copy[(1 * width + 7) * 4] == 0);
+}
@@ -0,0 +1,134 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 300;
+const size_t HEIGHT = 170;
+const size_t OCTAVES = 6;
+
+std::vector<float> makeMap(uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool) {
+	std::vector<float> map(WIDTH * HEIGHT);
+	generateMap(map.data(), WIDTH, HEIGHT, OCTAVES, 0.5f, 2.f, seed, source, noise, pool);
+	return map;
+}
+
+}
+
+TEST(generator, parallel_for_calls_every_index_once) {
+	for (size_t threads_n : { 1, 4 }) {
+		ThreadPool pool(threads_n);
+		for (size_t n : { 0, 1, 7, 1000 }) {
+			std::vector<std::atomic<int>> calls(n);
+			pool.parallelFor(n, [&](size_t i) { calls[i]++; });
+			bool once = true;
+			for (size_t i = 0; i < n; i++)
+			{
+				once = once && calls[i] == 1;
+			}
+			CHECK(once);
+		}
+	}
+}
+
+TEST(generator, same_seed_gives_same_map_on_any_pool) {
+	ThreadPool one(1);
+	ThreadPool four(4);
+	for (GradientSource source : { GradientSource::Grid, GradientSource::Hash }) {
+		for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+		{
+			std::vector<float> a = makeMap(11, source, (NoiseBackend)i, one);
+			CHECK(a == makeMap(11, source, (NoiseBackend)i, four));
+			CHECK(a != makeMap(12, source, (NoiseBackend)i, four));
+		}
+	}
+}
+
+TEST(generator, map_is_the_sum_of_its_octaves) {
+	ThreadPool pool(2);
+	std::vector<float> map = makeMap(5, GradientSource::Hash, NoiseBackend::Perlin, pool);
+	std::vector<float> sum(WIDTH * HEIGHT);
+	std::vector<float> layer(WIDTH * HEIGHT);
+	for (const OctaveSpec& spec : octaveSpecs(WIDTH, OCTAVES, 0.5f, 2.f, 5)) {
+		perlinNoise(layer.data(), WIDTH, HEIGHT, spec.grid_cell_size, spec.seed, GradientSource::Hash, pool);
+		for (size_t j = 0; j < sum.size(); j++)
+		{
+			sum[j] += layer[j] * spec.amplitude;
+		}
+	}
+	float max_error = 0;
+	for (size_t j = 0; j < sum.size(); j++)
+	{
+		max_error = std::max(max_error, std::abs(sum[j] - map[j]));
+	}
+	CHECK(max_error <= 1e-5f);
+}
+
+TEST(generator, octave_cell_sizes_stay_within_the_map) {
+	for (float lacunarity : { 0.01f, 0.5f, 2.f, 1000.f }) {
+		for (const OctaveSpec& spec : octaveSpecs(WIDTH, 12, 0.5f, lacunarity, 1)) {
+			CHECK(spec.grid_cell_size >= 1 && spec.grid_cell_size <= WIDTH);
+		}
+	}
+}
+
+TEST(generator, heights_stay_within_height_bound) {
+	ThreadPool pool(4);
+	for (NoiseBackend noise : { NoiseBackend::Perlin, NoiseBackend::Simplex }) {
+		for (uint32_t seed = 0; seed < 8; seed++)
+		{
+			float bound = heightBound(octaveSpecs(WIDTH, OCTAVES, 0.5f, 2.f, seed), noise);
+			std::vector<float> map = makeMap(seed, GradientSource::Hash, noise, pool);
+			CHECK(*std::max_element(map.begin(), map.end()) <= bound);
+			CHECK(*std::min_element(map.begin(), map.end()) >= -bound);
+		}
+	}
+}
+
+TEST(generator, parse_size_rejects_signs_and_junk) {
+	size_t value = 0;
+	CHECK(parseSize("42", value) && value == 42);
+	CHECK(!parseSize("-5", value));
+	CHECK(!parseSize(" -5", value));
+	CHECK(!parseSize("5-", value));
+	CHECK(!parseSize("", value));
+	CHECK(!parseSize("12a", value));
+	CHECK(!parseSize("99999999999999999999999", value));
+}
+
+TEST(generator, cancelled_token_stops_generation) {
+	ThreadPool pool(2);
+	std::vector<float> map(WIDTH * HEIGHT);
+	CancellationToken cancel;
+	cancel.cancel();
+	GenerationProgress progress;
+	CHECK(!generateMap(map.data(), WIDTH, HEIGHT, OCTAVES, 0.5f, 2.f, 1, GradientSource::Grid, NoiseBackend::Perlin, pool, &progress, &cancel));
+	CHECK(progress.done < progress.total || progress.total == 0);
+	CHECK(!perlinNoise(map.data(), WIDTH, HEIGHT, 32, 1, GradientSource::Hash, pool, nullptr, &cancel));
+
+	cancel.reset();
+	CHECK(generateMap(map.data(), WIDTH, HEIGHT, OCTAVES, 0.5f, 2.f, 1, GradientSource::Grid, NoiseBackend::Perlin, pool, &progress, &cancel));
+	CHECK(progress.total > 0 && progress.done == progress.total);
+}
+
+TEST(generator, cancel_from_another_thread_stops_a_running_map) {
+	const size_t size = 4096;
+	ThreadPool pool(2);
+	std::vector<float> map(size * size);
+	CancellationToken cancel;
+	GenerationProgress progress;
+	// Cancels as soon as the first tile is done, with thousands to go.
+	std::thread canceller([&]() {
+		while (progress.done == 0) std::this_thread::yield();
+		cancel.cancel();
+		});
+	bool finished = generateMap(map.data(), size, size, 10, 0.5f, 2.f, 1, GradientSource::Hash, NoiseBackend::Perlin, pool, &progress, &cancel);
+	canceller.join();
+	CHECK(!finished);
+	CHECK(progress.done < progress.total);
+}
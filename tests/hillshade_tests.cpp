@@ -0,0 +1,152 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Heights that change sharply from pixel to pixel, so a wrong neighbour
+// shows in the shading.
+std::vector<float> roughMap(size_t width, size_t height, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+	std::vector<float> map(width * height);
+	for (float& h : map) {
+		h = dist(rng);
+	}
+	return map;
+}
+
+// Colorized pixels with a different alpha at every pixel, in rows p_width
+// pixels long.
+std::vector<uint8_t> testPixels(const std::vector<float>& map, size_t width, size_t height, size_t p_width) {
+	std::vector<uint8_t> pixels(p_width * height * 4, 0x5A);
+	mapToPixels(map.data(), width, height, pixels.data(), p_width);
+	for (size_t i = 0; i < width * height; i++)
+	{
+		pixels[((i / width) * p_width + i % width) * 4 + 3] = (uint8_t)(i * 37);
+	}
+	return pixels;
+}
+
+// Shades every pixel one at a time as the header describes it: central
+// differences inside the map, one-sided ones at its edges.
+void referenceHillshade(const float* map, size_t width, size_t height, const Hillshade& shade, uint8_t* pixels, size_t p_width) {
+	const float radians = 3.14159265f / 180.f;
+	float azimuth = shade.azimuth * radians;
+	float altitude = std::min(90.f, std::max(1.f, shade.altitude)) * radians;
+	float lx = std::sin(azimuth) * std::cos(altitude);
+	float ly = -std::cos(azimuth) * std::cos(altitude);
+	float lz = std::sin(altitude);
+	for (size_t y = 0; y < height; y++)
+	{
+		size_t above = y > 0 ? y - 1 : y;
+		size_t below = y + 1 < height ? y + 1 : y;
+		float dy = (float)std::max<size_t>(1, below - above);
+		for (size_t x = 0; x < width; x++)
+		{
+			size_t left = x > 0 ? x - 1 : x;
+			size_t right = x + 1 < width ? x + 1 : x;
+			float dx = (float)std::max<size_t>(1, right - left);
+			float gx = (map[y * width + right] - map[y * width + left]) * (shade.relief / dx);
+			float gy = (map[below * width + x] - map[above * width + x]) * (shade.relief / dy);
+			float lambert = (lz - gx * lx - gy * ly) / std::sqrt(gx * gx + gy * gy + 1.f);
+			float factor = 1.f - shade.strength + shade.strength * std::max(0.f, lambert) / lz;
+			uint8_t* pixel = pixels + (y * p_width + x) * 4;
+			for (size_t c = 0; c < 3; c++)
+			{
+				pixel[c] = (uint8_t)std::min(255.f, pixel[c] * factor);
+			}
+		}
+	}
+}
+
+}
+
+TEST(hillshade, matches_scalar_reference) {
+	ThreadPool pool(3);
+	Hillshade shade;
+	shade.strength = 0.8f;
+	for (size_t width : { 1, 2, 5, 67, 130 }) {
+		for (size_t height : { 1, 3, 70 }) {
+			// Rows two pixels longer than the map.
+			size_t p_width = width + 2;
+			std::vector<float> map = roughMap(width, height, (uint32_t)(width * 100 + height));
+			std::vector<uint8_t> expected = testPixels(map, width, height, p_width);
+			std::vector<uint8_t> actual = expected;
+			referenceHillshade(map.data(), width, height, shade, expected.data(), p_width);
+			hillshade(map.data(), width, height, shade, actual.data(), p_width, pool);
+			CHECK(actual == expected);
+		}
+	}
+}
+
+TEST(hillshade, keeps_alpha_and_padding) {
+	ThreadPool pool(2);
+	const size_t width = 67;
+	const size_t height = 70;
+	const size_t p_width = 71;
+	std::vector<float> map = roughMap(width, height, 5);
+	std::vector<uint8_t> before = testPixels(map, width, height, p_width);
+	std::vector<uint8_t> pixels = before;
+	hillshade(map.data(), width, height, Hillshade(), pixels.data(), p_width, pool);
+	bool kept = true;
+	bool shaded = false;
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < p_width; x++)
+		{
+			size_t i = (y * p_width + x) * 4;
+			if (x >= width) {
+				kept = kept && std::equal(pixels.begin() + i, pixels.begin() + i + 4, before.begin() + i);
+				continue;
+			}
+			kept = kept && pixels[i + 3] == before[i + 3];
+			shaded = shaded || pixels[i] != before[i];
+		}
+	}
+	CHECK(kept);
+	CHECK(shaded);
+}
+
+TEST(hillshade, halo_update_matches_whole_map) {
+	ThreadPool pool(4);
+	const size_t width = 130;
+	const size_t height = 70;
+	std::vector<float> map = roughMap(width, height, 9);
+	std::vector<uint8_t> pixels = testPixels(map, width, height, width);
+	hillshade(map.data(), width, height, Hillshade(), pixels.data(), width, pool);
+
+	const DirtyRect rects[] = {
+		{ 40, 20, 33, 17 },
+		// Touching the left and top, then the right and bottom edges.
+		{ 0, 0, 5, 3 },
+		{ 125, 66, 5, 4 },
+		{ 64, 30, 1, 1 },
+	};
+	for (const DirtyRect& rect : rects) {
+		std::vector<float> changed = roughMap(width, height, (uint32_t)(rect.x + rect.y));
+		for (size_t y = rect.y; y < rect.y + rect.height; y++)
+		{
+			std::copy(changed.begin() + y * width + rect.x, changed.begin() + y * width + rect.x + rect.width, map.begin() + y * width + rect.x);
+		}
+		DirtyRect halo = hillshadeHalo(rect, width, height);
+		CHECK(halo.x + halo.width <= width && halo.y + halo.height <= height);
+		mapRectToPixels(map.data(), width, halo, pixels.data(), width);
+		for (size_t y = halo.y; y < halo.y + halo.height; y++)
+		{
+			for (size_t x = halo.x; x < halo.x + halo.width; x++)
+			{
+				pixels[(y * width + x) * 4 + 3] = (uint8_t)((y * width + x) * 37);
+			}
+		}
+		hillshadeRect(map.data(), width, height, halo, Hillshade(), pixels.data(), width, pool);
+
+		std::vector<uint8_t> expected = testPixels(map, width, height, width);
+		hillshade(map.data(), width, height, Hillshade(), expected.data(), width, pool);
+		CHECK(pixels == expected);
+	}
+}
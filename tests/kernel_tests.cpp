@@ -0,0 +1,183 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const uint32_t SEED = 7;
+const size_t WIDTH = 333;
+const size_t HEIGHT = 97;
+
+std::vector<SimdLevel> supportedLevels() {
+	std::vector<SimdLevel> levels;
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 }) {
+		if (level <= detectSimdLevel()) levels.push_back(level);
+	}
+	return levels;
+}
+
+// Gradients covering a WIDTH x HEIGHT map at cell size for backend.
+GradientField mapGradients(const NoiseBackendOps& backend, size_t size) {
+	size_t grid_w = 1 + (WIDTH - 1) / size + 1;
+	size_t grid_h = 1 + (HEIGHT - 1) / size + 1;
+	size_t padding = backend.lattice_padding(grid_w, grid_h);
+	return GradientField(GradientSource::Grid, SEED, grid_w + padding, grid_h + padding);
+}
+
+// Heights sweeping past both ends of [-1, 1].
+std::vector<float> heightRamp(size_t n) {
+	std::vector<float> map(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		map[i] = -1.25f + 2.5f * i / (n - 1);
+	}
+	return map;
+}
+
+}
+
+TEST(kernels, simd_noise_matches_scalar) {
+	std::vector<float> expected(WIDTH * HEIGHT);
+	std::vector<float> actual(WIDTH * HEIGHT);
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		const NoiseBackendOps& backend = noiseBackend((NoiseBackend)i);
+		for (size_t size : { 1, 7, 64, 318 }) {
+			GradientField gradients = mapGradients(backend, size);
+			backend.process_rect(expected.data(), WIDTH, gradients, size, 0, 0, WIDTH, HEIGHT, SimdLevel::Scalar, 1);
+			for (SimdLevel level : supportedLevels()) {
+				backend.process_rect(actual.data(), WIDTH, gradients, size, 0, 0, WIDTH, HEIGHT, level, 1);
+				float max_error = 0;
+				for (size_t j = 0; j < actual.size(); j++)
+				{
+					max_error = std::max(max_error, std::abs(actual[j] - expected[j]));
+				}
+				CHECK(max_error <= 1e-6f);
+			}
+		}
+	}
+}
+
+TEST(kernels, strided_noise_matches_full_resolution) {
+	const size_t step = 3;
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		const NoiseBackendOps& backend = noiseBackend((NoiseBackend)i);
+		GradientField gradients = mapGradients(backend, 32);
+		std::vector<float> full(WIDTH * HEIGHT);
+		backend.process_rect(full.data(), WIDTH, gradients, 32, 0, 0, WIDTH, HEIGHT, detectSimdLevel(), 1);
+		size_t samples_w = sampleCount(WIDTH, step);
+		size_t samples_h = sampleCount(HEIGHT, step);
+		std::vector<float> strided(samples_w * samples_h);
+		backend.process_rect(strided.data(), samples_w, gradients, 32, 0, 0, samples_w, samples_h, detectSimdLevel(), step);
+		bool same = true;
+		for (size_t y = 0; y < samples_h; y++)
+		{
+			for (size_t x = 0; x < samples_w; x++)
+			{
+				same = same && strided[y * samples_w + x] == full[y * step * WIDTH + x * step];
+			}
+		}
+		CHECK(same);
+	}
+}
+
+TEST(kernels, perlin_is_zero_on_lattice_points) {
+	const size_t size = 16;
+	const NoiseBackendOps& perlin = noiseBackend(NoiseBackend::Perlin);
+	GradientField gradients = mapGradients(perlin, size);
+	std::vector<float> map(WIDTH * HEIGHT);
+	perlin_process_rect(map.data(), WIDTH, gradients, size, 0, 0, WIDTH, HEIGHT, perlinSpanKernel(detectSimdLevel()));
+	bool zero = true;
+	bool nonzero_between = false;
+	for (size_t y = 0; y < HEIGHT; y += size)
+	{
+		for (size_t x = 0; x < WIDTH; x++)
+		{
+			if (x % size == 0) zero = zero && map[y * WIDTH + x] == 0.f;
+		}
+	}
+	for (size_t i = 0; i < map.size(); i++)
+	{
+		nonzero_between = nonzero_between || map[i] != 0.f;
+	}
+	CHECK(zero);
+	CHECK(nonzero_between);
+}
+
+TEST(kernels, noise_stays_within_backend_bound) {
+	std::vector<float> map(WIDTH * HEIGHT);
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		const NoiseBackendOps& backend = noiseBackend((NoiseBackend)i);
+		float largest = 0;
+		for (uint32_t seed = 0; seed < 48; seed++)
+		{
+			for (size_t size : { 2, 5, 16, 41, 128 }) {
+				size_t grid_w = 1 + (WIDTH - 1) / size + 1;
+				size_t grid_h = 1 + (HEIGHT - 1) / size + 1;
+				size_t padding = backend.lattice_padding(grid_w, grid_h);
+				GradientField gradients(GradientSource::Hash, seed, grid_w + padding, grid_h + padding);
+				backend.process_rect(map.data(), WIDTH, gradients, size, 0, 0, WIDTH, HEIGHT, detectSimdLevel(), 1);
+				for (float v : map) {
+					largest = std::max(largest, std::abs(v));
+				}
+			}
+		}
+		CHECK(largest <= backend.bound);
+		// The sweep gets close to the bound, or it proves little.
+		CHECK(largest >= 0.9f * backend.bound);
+	}
+}
+
+TEST(kernels, hashed_gradients_are_unit_vectors_and_repeatable) {
+	GradientField a(GradientSource::Hash, SEED);
+	GradientField b(GradientSource::Hash, SEED);
+	GradientField other(GradientSource::Hash, SEED + 1);
+	size_t differing = 0;
+	for (int64_t y = -20; y < 20; y++)
+	{
+		for (int64_t x = -20; x < 20; x++)
+		{
+			Vec2f g = a.at(x, y);
+			CHECK_NEAR(g.x * g.x + g.y * g.y, 1.f, 1e-5f);
+			CHECK(g.x == b.at(x, y).x && g.y == b.at(x, y).y);
+			Vec2f h = other.at(x, y);
+			differing += g.x != h.x || g.y != h.y;
+		}
+	}
+	CHECK(differing > 0);
+}
+
+TEST(kernels, simd_colorize_matches_scalar) {
+	std::vector<float> map = heightRamp(1001);
+	std::vector<uint8_t> expected(map.size() * 4);
+	std::vector<uint8_t> actual(map.size() * 4);
+	colorizeKernel(SimdLevel::Scalar)(map.data(), map.size(), expected.data());
+	for (SimdLevel level : supportedLevels()) {
+		colorizeKernel(level)(map.data(), map.size(), actual.data());
+		CHECK(actual == expected);
+	}
+
+	Colormap colormap(biomeStops());
+	colormapKernel(SimdLevel::Scalar)(map.data(), map.size(), colormap.lut(), expected.data());
+	for (SimdLevel level : supportedLevels()) {
+		colormapKernel(level)(map.data(), map.size(), colormap.lut(), actual.data());
+		CHECK(actual == expected);
+	}
+}
+
+TEST(kernels, colorize_saturates_to_opaque_gray) {
+	const float heights[] = { -2.f, -1.f, 0.f, 1.f, 2.f };
+	uint8_t pixels[5 * 4];
+	colorizeKernel(detectSimdLevel())(heights, 5, pixels);
+	CHECK(pixels[0] == 0 && pixels[4] == 0);
+	CHECK(pixels[12] == 255 && pixels[16] == 255);
+	for (size_t i = 0; i < 5; i++)
+	{
+		CHECK(pixels[i * 4] == pixels[i * 4 + 1] && pixels[i * 4] == pixels[i * 4 + 2]);
+		CHECK(pixels[i * 4 + 3] == 255);
+	}
+}
@@ -0,0 +1,95 @@
+#include "test.h"
+#include "test_files.h"
+#include "worldgen.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 90;
+const size_t HEIGHT = 50;
+
+// Waits for the export to finish. Returns false on timeout.
+bool waitIdle(const MapExporter& exporter) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (exporter.busy()) {
+		if (std::chrono::steady_clock::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+std::shared_ptr<std::vector<float>> testMap() {
+	ThreadPool pool(2);
+	auto map = std::make_shared<std::vector<float>>(WIDTH * HEIGHT);
+	generateMap(map->data(), WIDTH, HEIGHT, 4, 0.5f, 2.f, 21, GradientSource::Hash, NoiseBackend::Perlin, pool);
+	return map;
+}
+
+}
+
+TEST(map_exporter, writes_heightmaps_in_the_background) {
+	std::shared_ptr<std::vector<float>> map = testMap();
+	MapExporter exporter;
+	CHECK(exporter.status().empty());
+	CHECK(exporter.exportHeightmap("exporter_test.r32", map, WIDTH, HEIGHT));
+	CHECK(waitIdle(exporter));
+	CHECK(exporter.status() == "Wrote exporter_test.r32");
+	CHECK(exporter.progress() == 1.f);
+	// The exporter let go of the map.
+	CHECK(map.use_count() == 1);
+	std::vector<uint8_t> r32 = readFile("exporter_test.r32");
+	remove("exporter_test.r32");
+	CHECK(r32.size() == map->size() * sizeof(float) && memcmp(r32.data(), map->data(), r32.size()) == 0);
+
+	CHECK(exporter.exportHeightmap("exporter_test.png", map, WIDTH, HEIGHT));
+	CHECK(waitIdle(exporter));
+	DecodedPng png;
+	CHECK(decodePng(readFile("exporter_test.png"), png));
+	remove("exporter_test.png");
+	CHECK(png.width == WIDTH && png.height == HEIGHT && png.bit_depth == 16);
+	bool same = png.pixels.size() == map->size() * 2;
+	for (size_t i = 0; same && i < map->size(); i++)
+	{
+		same = loadBigEndian16(png.pixels.data() + i * 2) == heightSample16((*map)[i]);
+	}
+	CHECK(same);
+}
+
+TEST(map_exporter, writes_pixels_as_png) {
+	std::shared_ptr<std::vector<float>> map = testMap();
+	auto pixels = std::make_shared<std::vector<uint8_t>>(WIDTH * HEIGHT * 4);
+	mapToPixels(map->data(), WIDTH, HEIGHT, pixels->data(), WIDTH);
+	MapExporter exporter;
+	CHECK(exporter.exportPixels("exporter_test_pixels.png", pixels, WIDTH, HEIGHT));
+	CHECK(waitIdle(exporter));
+	CHECK(exporter.status() == "Wrote exporter_test_pixels.png");
+	DecodedPng png;
+	CHECK(decodePng(readFile("exporter_test_pixels.png"), png));
+	remove("exporter_test_pixels.png");
+	CHECK(png.color_type == 6 && png.pixels == *pixels);
+}
+
+TEST(map_exporter, reports_failures) {
+	std::shared_ptr<std::vector<float>> map = testMap();
+	MapExporter exporter;
+	// Unknown extensions start nothing.
+	CHECK(!exporter.exportHeightmap("exporter_test.xyz", map, WIDTH, HEIGHT));
+	CHECK(!exporter.busy());
+	CHECK(exporter.status().empty());
+
+	CHECK(exporter.exportHeightmap("no_such_directory/exporter_test.r16", map, WIDTH, HEIGHT));
+	CHECK(waitIdle(exporter));
+	CHECK(exporter.status() == "Failed to write no_such_directory/exporter_test.r16");
+	CHECK(map.use_count() == 1);
+
+	auto pixels = std::make_shared<std::vector<uint8_t>>(WIDTH * HEIGHT * 4);
+	CHECK(exporter.exportPixels("no_such_directory/exporter_test.png", pixels, WIDTH, HEIGHT));
+	CHECK(waitIdle(exporter));
+	CHECK(exporter.status() == "Failed to write no_such_directory/exporter_test.png");
+}
@@ -0,0 +1,143 @@
+#include "test.h"
+#include "test_files.h"
+#include "worldgen.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 150;
+// Not a multiple of TILE_SIZE, so the last band is short.
+const size_t HEIGHT = 83;
+const char* PATH = "mapped_test.wghm";
+
+MappedHeightmapHeader validHeader(SampleType type) {
+	MappedHeightmapHeader header;
+	memcpy(header.magic, "WGHM", 4);
+	header.version = 1;
+	header.sample_type = (uint32_t)type;
+	header.header_size = sizeof(header);
+	header.width = 4;
+	header.height = 3;
+	return header;
+}
+
+// Writes header followed by sample_bytes zero bytes to PATH.
+bool writeFile(const MappedHeightmapHeader& header, size_t sample_bytes) {
+	FILE* file = fopen(PATH, "wb");
+	if (!file) return false;
+	std::vector<uint8_t> samples(sample_bytes, 0);
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(samples.data(), 1, samples.size(), file) == samples.size();
+	return fclose(file) == 0 && ok;
+}
+
+bool opens(const MappedHeightmapHeader& header, size_t sample_bytes) {
+	if (!writeFile(header, sample_bytes)) return false;
+	MappedHeightmap mapped;
+	bool ok = mapped.open(PATH);
+	mapped.close();
+	return ok;
+}
+
+}
+
+TEST(mapped_heightmap, open_reads_what_create_wrote) {
+	for (SampleType type : { SampleType::Float32, SampleType::Uint16 }) {
+		MappedHeightmap created;
+		CHECK(created.create(PATH, WIDTH, HEIGHT, type));
+		memset(created.row(HEIGHT - 1), 0x3C, WIDTH * created.sampleSize());
+		CHECK(created.close());
+
+		std::vector<uint8_t> file = readFile(PATH);
+		CHECK(file.size() == sizeof(MappedHeightmapHeader) + WIDTH * HEIGHT * created.sampleSize());
+		CHECK(memcmp(file.data(), "WGHM", 4) == 0);
+		CHECK(loadLittleEndian32(file.data() + 4) == 1);
+		CHECK(loadLittleEndian32(file.data() + 8) == (uint32_t)type);
+		CHECK(loadLittleEndian32(file.data() + 12) == sizeof(MappedHeightmapHeader));
+		CHECK(loadLittleEndian64(file.data() + 16) == WIDTH && loadLittleEndian64(file.data() + 24) == HEIGHT);
+
+		MappedHeightmap opened;
+		CHECK(opened.open(PATH));
+		CHECK(opened.width() == WIDTH && opened.height() == HEIGHT && opened.sampleType() == type);
+		CHECK(opened.row(HEIGHT - 1)[0] == 0x3C && opened.row(HEIGHT - 1)[WIDTH * opened.sampleSize() - 1] == 0x3C);
+		CHECK(opened.close());
+	}
+	remove(PATH);
+}
+
+TEST(mapped_heightmap, open_rejects_bad_files) {
+	const size_t float_bytes = 4 * 3 * sizeof(float);
+	CHECK(opens(validHeader(SampleType::Float32), float_bytes));
+	CHECK(opens(validHeader(SampleType::Uint16), 4 * 3 * sizeof(uint16_t)));
+
+	MappedHeightmapHeader header = validHeader(SampleType::Float32);
+	header.magic[3] = 'X';
+	CHECK(!opens(header, float_bytes));
+
+	header = validHeader(SampleType::Float32);
+	header.version = 2;
+	CHECK(!opens(header, float_bytes));
+
+	header = validHeader(SampleType::Float32);
+	header.header_size = sizeof(header) + 8;
+	CHECK(!opens(header, float_bytes));
+
+	header = validHeader(SampleType::Float32);
+	header.sample_type = 2;
+	CHECK(!opens(header, float_bytes));
+
+	// Samples cut short, and a header cut short.
+	CHECK(!opens(validHeader(SampleType::Float32), float_bytes - 1));
+	FILE* file = fopen(PATH, "wb");
+	CHECK(file != nullptr && fwrite("WGHM", 1, 4, file) == 4);
+	if (file) fclose(file);
+	MappedHeightmap mapped;
+	CHECK(!mapped.open(PATH));
+	remove(PATH);
+	CHECK(!mapped.open("no_such_directory/mapped_test.wghm"));
+}
+
+TEST(mapped_heightmap, generated_file_matches_generate_map) {
+	ThreadPool pool(3);
+	std::vector<float> map(WIDTH * HEIGHT);
+	generateMap(map.data(), WIDTH, HEIGHT, 5, 0.5f, 2.f, 13, GradientSource::Hash, NoiseBackend::Simplex, pool);
+	for (SampleType type : { SampleType::Float32, SampleType::Uint16 }) {
+		MappedHeightmap created;
+		CHECK(created.create(PATH, WIDTH, HEIGHT, type));
+		GenerationProgress progress;
+		CHECK(generateMapToFile(created, 5, 0.5f, 2.f, 13, GradientSource::Hash, NoiseBackend::Simplex, pool, &progress));
+		CHECK(progress.done == progress.total);
+		CHECK(created.close());
+
+		MappedHeightmap opened;
+		CHECK(opened.open(PATH));
+		bool same = true;
+		for (size_t y = 0; y < HEIGHT; y++)
+		{
+			const uint8_t* row = opened.row(y);
+			for (size_t x = 0; x < WIDTH; x++)
+			{
+				float expected = map[y * WIDTH + x];
+				if (type == SampleType::Float32) same = same && memcmp(row + x * sizeof(float), &expected, sizeof(float)) == 0;
+				else same = same && loadLittleEndian16(row + x * 2) == heightSample16(expected);
+			}
+		}
+		CHECK(same);
+		CHECK(opened.close());
+	}
+	remove(PATH);
+}
+
+TEST(mapped_heightmap, cancelled_generation_fails) {
+	ThreadPool pool(2);
+	MappedHeightmap created;
+	CHECK(created.create(PATH, WIDTH, HEIGHT, SampleType::Uint16));
+	CancellationToken cancel;
+	cancel.cancel();
+	CHECK(!generateMapToFile(created, 5, 0.5f, 2.f, 13, GradientSource::Hash, NoiseBackend::Perlin, pool, nullptr, &cancel));
+	created.close();
+	remove(PATH);
+}
@@ -0,0 +1,66 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <vector>
+
+namespace {
+
+const size_t WIDTH = 240;
+const size_t HEIGHT = 130;
+
+std::vector<float> freshMap(size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool) {
+	std::vector<float> map(WIDTH * HEIGHT);
+	generateMap(map.data(), WIDTH, HEIGHT, octaves, persistence, lacunarity, seed, source, noise, pool);
+	return map;
+}
+
+std::vector<float> cachedMap(OctaveCache& cache, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool) {
+	std::vector<float> map(WIDTH * HEIGHT);
+	cache.generate(map.data(), octaves, persistence, lacunarity, seed, source, noise, pool);
+	return map;
+}
+
+}
+
+TEST(octave_cache, maps_match_generate_map) {
+	ThreadPool pool(2);
+	for (GradientSource source : { GradientSource::Grid, GradientSource::Hash }) {
+		for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+		{
+			NoiseBackend noise = (NoiseBackend)i;
+			OctaveCache cache(WIDTH, HEIGHT);
+			// Fresh layers, a re-sum, a moved lacunarity and an added octave.
+			CHECK(cachedMap(cache, 5, 0.5f, 2.f, 9, source, noise, pool) == freshMap(5, 0.5f, 2.f, 9, source, noise, pool));
+			CHECK(cache.missingLayers(5, 2.f, 9, source, noise) == 0);
+			CHECK(cachedMap(cache, 5, 0.7f, 2.f, 9, source, noise, pool) == freshMap(5, 0.7f, 2.f, 9, source, noise, pool));
+			CHECK(cache.missingLayers(5, 2.5f, 9, source, noise) > 0);
+			CHECK(cachedMap(cache, 5, 0.7f, 2.5f, 9, source, noise, pool) == freshMap(5, 0.7f, 2.5f, 9, source, noise, pool));
+			CHECK(cache.missingLayers(6, 2.5f, 9, source, noise) == 1);
+			CHECK(cachedMap(cache, 6, 0.7f, 2.5f, 9, source, noise, pool) == freshMap(6, 0.7f, 2.5f, 9, source, noise, pool));
+		}
+	}
+}
+
+TEST(octave_cache, eviction_keeps_at_most_max_layers) {
+	ThreadPool pool(2);
+	const GradientSource source = GradientSource::Hash;
+	const NoiseBackend noise = NoiseBackend::Perlin;
+	OctaveCache cache(WIDTH, HEIGHT, 4);
+	cachedMap(cache, 3, 0.5f, 2.f, 1, source, noise, pool);
+	CHECK(cache.missingLayers(3, 2.f, 1, source, noise) == 0);
+
+	// Two layers of another seed fit by dropping the least recently used
+	// layer of the first.
+	cachedMap(cache, 2, 0.5f, 2.f, 2, source, noise, pool);
+	CHECK(cache.missingLayers(2, 2.f, 2, source, noise) == 0);
+	CHECK(cache.missingLayers(3, 2.f, 1, source, noise) == 1);
+
+	// More octaves than max_layers: the map is still right, and at most four
+	// of its layers stay cached.
+	CHECK(cachedMap(cache, 7, 0.5f, 2.f, 3, source, noise, pool) == freshMap(7, 0.5f, 2.f, 3, source, noise, pool));
+	size_t cached = (3 - cache.missingLayers(3, 2.f, 1, source, noise))
+		+ (2 - cache.missingLayers(2, 2.f, 2, source, noise))
+		+ (7 - cache.missingLayers(7, 2.f, 3, source, noise));
+	CHECK(cached <= 4);
+	CHECK(cachedMap(cache, 7, 0.5f, 2.f, 3, source, noise, pool) == freshMap(7, 0.5f, 2.f, 3, source, noise, pool));
+}
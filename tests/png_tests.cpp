@@ -0,0 +1,156 @@
+#include "test.h"
+#include "test_files.h"
+#include "worldgen.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<float> testMap(size_t width, size_t height) {
+	ThreadPool pool(2);
+	std::vector<float> map(width * height);
+	generateMap(map.data(), width, height, 6, 0.5f, 2.f, 3, GradientSource::Hash, NoiseBackend::Perlin, pool);
+	// Heights past both ends of the range must clamp.
+	map[0] = -3.f;
+	map[1] = 3.f;
+	return map;
+}
+
+// Writes a Gray16 PNG of map through PngWriter directly.
+bool writeGray16(const std::string& path, const std::vector<float>& map, size_t width, size_t height, bool compress) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	std::vector<uint8_t> row(width * 2);
+	bool ok;
+	{
+		PngWriter png(file, width, height, PngWriter::Format::Gray16, compress);
+		for (size_t y = 0; y < height; y++)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				uint16_t sample = heightSample16(map[y * width + x]);
+				row[x * 2] = (uint8_t)(sample >> 8);
+				row[x * 2 + 1] = (uint8_t)sample;
+			}
+			png.writeRows(row.data(), 1);
+		}
+		ok = png.finish();
+	}
+	return fclose(file) == 0 && ok;
+}
+
+bool samplesMatch(const DecodedPng& png, const std::vector<float>& map) {
+	if (png.pixels.size() != map.size() * 2) return false;
+	for (size_t i = 0; i < map.size(); i++)
+	{
+		if (loadBigEndian16(png.pixels.data() + i * 2) != heightSample16(map[i])) return false;
+	}
+	return true;
+}
+
+}
+
+TEST(png, gray16_decodes_with_and_without_compression) {
+	// Large enough for several stored blocks and IDAT chunks.
+	const size_t width = 700;
+	const size_t height = 260;
+	std::vector<float> map = testMap(width, height);
+	for (bool compress : { true, false }) {
+		const std::string path = compress ? "png_test_deflate.png" : "png_test_stored.png";
+		CHECK(writeGray16(path, map, width, height, compress));
+		std::vector<uint8_t> file = readFile(path);
+		remove(path.c_str());
+		DecodedPng png;
+		CHECK(decodePng(file, png));
+		CHECK(png.width == width && png.height == height);
+		CHECK(png.bit_depth == 16 && png.color_type == 0);
+		CHECK(samplesMatch(png, map));
+		if (!compress) {
+			CHECK(png.idat_chunks > 1);
+			// Stored blocks carry every filtered byte.
+			CHECK(file.size() > height * (width * 2 + 1));
+		}
+	}
+}
+
+TEST(png, heightmap_and_pixel_exports_decode) {
+	const size_t width = 130;
+	const size_t height = 70;
+	std::vector<float> map = testMap(width, height);
+	CHECK(writeHeightmap("png_test_heightmap.png", map.data(), width, height, HeightmapFormat::Png16));
+	DecodedPng heightmap;
+	CHECK(decodePng(readFile("png_test_heightmap.png"), heightmap));
+	remove("png_test_heightmap.png");
+	CHECK(samplesMatch(heightmap, map));
+	CHECK(heightSample16(-3.f) == 0 && heightSample16(3.f) == 65535);
+
+	std::vector<uint8_t> pixels(width * height * 4);
+	mapToPixels(map.data(), width, height, pixels.data(), width);
+	CHECK(writePixelsPng("png_test_pixels.png", pixels.data(), width, height));
+	DecodedPng image;
+	CHECK(decodePng(readFile("png_test_pixels.png"), image));
+	remove("png_test_pixels.png");
+	CHECK(image.bit_depth == 8 && image.color_type == 6);
+	CHECK(image.pixels == pixels);
+}
+
+TEST(png, raw_exports_hold_the_samples) {
+	const size_t width = 33;
+	const size_t height = 9;
+	std::vector<float> map = testMap(width, height);
+
+	CHECK(writeHeightmap("png_test.r32", map.data(), width, height, HeightmapFormat::RawFloat32));
+	std::vector<uint8_t> r32 = readFile("png_test.r32");
+	remove("png_test.r32");
+	CHECK(r32.size() == map.size() * 4 && memcmp(r32.data(), map.data(), r32.size()) == 0);
+
+	CHECK(writeHeightmap("png_test.r16", map.data(), width, height, HeightmapFormat::RawUint16));
+	std::vector<uint8_t> r16 = readFile("png_test.r16");
+	remove("png_test.r16");
+	bool same = r16.size() == map.size() * 2;
+	for (size_t i = 0; same && i < map.size(); i++)
+	{
+		same = loadLittleEndian16(r16.data() + i * 2) == heightSample16(map[i]);
+	}
+	CHECK(same);
+
+	CHECK(writeHeightmap("png_test.pgm", map.data(), width, height, HeightmapFormat::Pgm16));
+	std::vector<uint8_t> pgm = readFile("png_test.pgm");
+	remove("png_test.pgm");
+	const std::string header = "P5\n33 9\n65535\n";
+	CHECK(pgm.size() == header.size() + map.size() * 2 && memcmp(pgm.data(), header.data(), header.size()) == 0);
+}
+
+TEST(png, row_count_must_match_the_height) {
+	const size_t width = 20;
+	const size_t height = 10;
+	std::vector<uint8_t> rows(width * 4 * (height + 1), 0x7F);
+	for (size_t written : { height - 1, height + 1 }) {
+		FILE* file = fopen("png_test_rows.png", "wb");
+		CHECK(file != nullptr);
+		if (!file) return;
+		PngWriter png(file, width, height, PngWriter::Format::Rgba8);
+		bool rows_ok = png.writeRows(rows.data(), written);
+		CHECK(rows_ok == (written <= height));
+		CHECK(!png.finish());
+		fclose(file);
+	}
+	remove("png_test_rows.png");
+
+	// Rows in several calls add up.
+	FILE* file = fopen("png_test_rows.png", "wb");
+	CHECK(file != nullptr);
+	if (!file) return;
+	{
+		PngWriter png(file, width, height, PngWriter::Format::Rgba8);
+		CHECK(png.writeRows(rows.data(), 4));
+		CHECK(png.writeRows(rows.data(), 6));
+		CHECK(!png.writeRows(rows.data(), 1));
+		CHECK(!png.finish());
+	}
+	fclose(file);
+	remove("png_test_rows.png");
+}
@@ -0,0 +1,50 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <vector>
+
+TEST(progressive, levels_and_map_match_generate_map) {
+	ThreadPool pool(2);
+	const size_t sizes[][2] = { { 257, 129 }, { 320, 200 }, { 9, 5 } };
+	for (const size_t* size : sizes) {
+		size_t width = size[0];
+		size_t height = size[1];
+		for (GradientSource source : { GradientSource::Grid, GradientSource::Hash }) {
+			std::vector<float> expected(width * height);
+			generateMap(expected.data(), width, height, 7, 0.5f, 2.f, 21, source, NoiseBackend::Perlin, pool);
+
+			std::vector<size_t> steps;
+			bool levels_match = true;
+			auto on_level = [&](const float* level, size_t step) {
+				steps.push_back(step);
+				size_t samples_w = sampleCount(width, step);
+				for (size_t y = 0; y < height; y += step)
+				{
+					for (size_t x = 0; x < width; x += step)
+					{
+						levels_match = levels_match && level[y / step * samples_w + x / step] == expected[y * width + x];
+					}
+				}
+			};
+			std::vector<float> map(width * height);
+			GenerationProgress progress;
+			CHECK(generateMapProgressive(map.data(), width, height, 7, 0.5f, 2.f, 21, source, NoiseBackend::Perlin, pool, on_level, &progress));
+			CHECK(map == expected);
+			CHECK(levels_match);
+			CHECK((steps == std::vector<size_t>{ PREVIEW_STEP, PREVIEW_STEP / 2, PREVIEW_STEP / 4 }));
+			CHECK(progress.done == progress.total);
+		}
+	}
+}
+
+TEST(progressive, expand_level_repeats_samples) {
+	const float level[] = { 1, 2, 3, 4, 5, 6 };
+	std::vector<float> map(5 * 3);
+	expandLevel(level, 2, map.data(), 5, 3);
+	const float expected[] = {
+		1, 1, 2, 2, 3,
+		1, 1, 2, 2, 3,
+		4, 4, 5, 5, 6,
+	};
+	CHECK(std::vector<float>(expected, expected + 15) == map);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal test registry, so the tests need nothing beyond the worldgen
+// library. TEST(suite, name) defines a test; worldgen-tests runs every test
+// or, given suite names, the tests of those suites.
+
+typedef void (*TestFunction)();
+
+struct TestRegistrar {
+	TestRegistrar(const char* suite, const char* name, TestFunction fn);
+};
+
+// Records a failed check of the running test.
+void testFailed(const char* file, int line, const char* expression);
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) testFailed(__FILE__, __LINE__, #condition); \
+	} while (0)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::abs((a) - (b)) <= (tolerance))
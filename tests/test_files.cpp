@@ -0,0 +1,162 @@
+#include "test_files.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef WG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+uint32_t adler32Of(const std::vector<uint8_t>& data) {
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint8_t byte : data) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	return b << 16 | a;
+}
+
+// Decodes a stream whose blocks are all stored. Returns false at the first
+// block that isn't.
+bool inflateStored(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+	size_t pos = 2;
+	bool final_block = false;
+	while (!final_block) {
+		if (pos + 5 > size || (data[pos] & 0x06) != 0) return false;
+		final_block = (data[pos] & 1) != 0;
+		uint16_t len = loadLittleEndian16(data + pos + 1);
+		uint16_t nlen = loadLittleEndian16(data + pos + 3);
+		if ((uint16_t)~len != nlen || pos + 5 + len > size) return false;
+		out.insert(out.end(), data + pos + 5, data + pos + 5 + len);
+		pos += 5 + len;
+	}
+	return pos + 4 == size && loadBigEndian32(data + pos) == adler32Of(out);
+}
+
+uint32_t crc32Of(const uint8_t* data, size_t size) {
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (int k = 0; k < 8; k++)
+		{
+			crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+		}
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+int paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return pb <= pc ? b : c;
+}
+
+}
+
+std::vector<uint8_t> readFile(const std::string& path) {
+	std::vector<uint8_t> data;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return data;
+	uint8_t buffer[1 << 16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + n);
+	}
+	fclose(file);
+	return data;
+}
+
+bool inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+	out.clear();
+	if (size < 6 || (data[0] & 0x0F) != 8 || loadBigEndian16(data) % 31 != 0) return false;
+	if (inflateStored(data, size, out)) return true;
+	out.clear();
+#ifdef WG_HAVE_ZLIB
+	z_stream stream{};
+	if (inflateInit(&stream) != Z_OK) return false;
+	stream.next_in = const_cast<uint8_t*>(data);
+	stream.avail_in = (uInt)size;
+	uint8_t buffer[1 << 16];
+	int result;
+	do {
+		stream.next_out = buffer;
+		stream.avail_out = sizeof(buffer);
+		result = inflate(&stream, Z_NO_FLUSH);
+		out.insert(out.end(), buffer, buffer + (sizeof(buffer) - stream.avail_out));
+	} while (result == Z_OK);
+	bool ok = result == Z_STREAM_END && stream.avail_in == 0;
+	inflateEnd(&stream);
+	return ok;
+#else
+	return false;
+#endif
+}
+
+bool decodePng(const std::vector<uint8_t>& file, DecodedPng& png) {
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0) return false;
+	std::vector<uint8_t> idat;
+	bool ended = false;
+	for (size_t pos = 8; !ended; ) {
+		if (pos + 12 > file.size()) return false;
+		uint32_t length = loadBigEndian32(file.data() + pos);
+		if (pos + 12 + length > file.size()) return false;
+		const uint8_t* type = file.data() + pos + 4;
+		const uint8_t* data = type + 4;
+		if (crc32Of(type, length + 4) != loadBigEndian32(data + length)) return false;
+		if (memcmp(type, "IHDR", 4) == 0) {
+			png.width = loadBigEndian32(data);
+			png.height = loadBigEndian32(data + 4);
+			png.bit_depth = data[8];
+			png.color_type = data[9];
+		}
+		else if (memcmp(type, "IDAT", 4) == 0) {
+			idat.insert(idat.end(), data, data + length);
+			png.idat_chunks++;
+		}
+		else if (memcmp(type, "IEND", 4) == 0) {
+			ended = pos + 12 == file.size();
+			if (!ended) return false;
+		}
+		pos += 12 + length;
+	}
+
+	std::vector<uint8_t> filtered;
+	if (!inflateZlib(idat.data(), idat.size(), filtered)) return false;
+	size_t channels = png.color_type == 6 ? 4 : 1;
+	size_t bpp = channels * png.bit_depth / 8;
+	size_t row_bytes = png.width * bpp;
+	if (filtered.size() != png.height * (row_bytes + 1)) return false;
+	png.pixels.assign(png.height * row_bytes, 0);
+	for (size_t y = 0; y < png.height; y++)
+	{
+		const uint8_t* in = filtered.data() + y * (row_bytes + 1);
+		uint8_t* row = png.pixels.data() + y * row_bytes;
+		const uint8_t* up = y > 0 ? row - row_bytes : nullptr;
+		for (size_t i = 0; i < row_bytes; i++)
+		{
+			int a = i >= bpp ? row[i - bpp] : 0;
+			int b = up ? up[i] : 0;
+			int c = up && i >= bpp ? up[i - bpp] : 0;
+			int predictor;
+			switch (in[0]) {
+			case 0: predictor = 0; break;
+			case 1: predictor = a; break;
+			case 2: predictor = b; break;
+			case 3: predictor = (a + b) / 2; break;
+			case 4: predictor = paeth(a, b, c); break;
+			default: return false;
+			}
+			row[i] = (uint8_t)(in[i + 1] + predictor);
+		}
+	}
+	return true;
+}
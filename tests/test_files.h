@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers for tests that read back files written by the library.
+
+// Whole contents of path, or empty if it can't be read.
+std::vector<uint8_t> readFile(const std::string& path);
+
+// Decodes a zlib stream into out. Streams of stored blocks are decoded
+// here, compressed ones through zlib when the build has it. Returns false
+// if the stream is malformed or its Adler-32 doesn't match.
+bool inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// A PNG as decodePng reads it.
+struct DecodedPng {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t bit_depth = 0;
+	uint8_t color_type = 0;
+	size_t idat_chunks = 0;
+	// Unfiltered rows, samples as stored in the file.
+	std::vector<uint8_t> pixels;
+};
+
+// Decodes the grayscale and RGBA PNGs PngWriter writes. Checks the
+// signature, every chunk CRC, the zlib stream and the filters. Returns
+// false if any of them is wrong.
+bool decodePng(const std::vector<uint8_t>& file, DecodedPng& png);
+
+inline uint16_t loadBigEndian16(const uint8_t* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+inline uint32_t loadBigEndian32(const uint8_t* p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+inline uint16_t loadLittleEndian16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+inline uint32_t loadLittleEndian32(const uint8_t* p) { return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+inline uint64_t loadLittleEndian64(const uint8_t* p) { return loadLittleEndian32(p) | (uint64_t)loadLittleEndian32(p + 4) << 32; }
@@ -0,0 +1,56 @@
+#include "test.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct TestCase {
+	const char* suite;
+	const char* name;
+	TestFunction fn;
+};
+
+std::vector<TestCase>& testCases() {
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+size_t failed_checks = 0;
+
+}
+
+TestRegistrar::TestRegistrar(const char* suite, const char* name, TestFunction fn) {
+	testCases().push_back({ suite, name, fn });
+}
+
+void testFailed(const char* file, int line, const char* expression) {
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+	failed_checks++;
+}
+
+int main(int argc, char** argv) {
+	size_t run = 0;
+	size_t failed = 0;
+	for (const TestCase& test : testCases()) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; i++)
+		{
+			selected = selected || strcmp(argv[i], test.suite) == 0;
+		}
+		if (!selected) continue;
+
+		size_t before = failed_checks;
+		test.fn();
+		bool ok = failed_checks == before;
+		printf("%s %s.%s\n", ok ? "ok  " : "FAIL", test.suite, test.name);
+		run++;
+		failed += !ok;
+	}
+	if (run == 0) {
+		fprintf(stderr, "no tests matched\n");
+		return 1;
+	}
+	printf("%zu of %zu tests passed\n", run - failed, run);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+#include "test.h"
+#include "test_files.h"
+#include "worldgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+#ifdef WG_HAVE_ZLIB
+const bool DEFLATES = true;
+#else
+// Without zlib the writer stores tiles uncompressed.
+const bool DEFLATES = false;
+#endif
+
+// Integer values of the SHORT, LONG and LONG8 tags of one directory, and
+// the DOUBLE ones.
+struct Directory {
+	std::map<uint16_t, std::vector<uint64_t>> values;
+	std::map<uint16_t, std::vector<double>> doubles;
+
+	uint64_t value(uint16_t tag) const {
+		auto it = values.find(tag);
+		return it == values.end() || it->second.empty() ? 0 : it->second[0];
+	}
+};
+
+struct ParsedTiff {
+	bool big = false;
+	uint64_t first_directory = 0;
+	std::vector<Directory> directories;
+};
+
+// Walks the header and the chain of directories. Returns false if any
+// offset points outside the file, a type isn't one the writer uses or a
+// directory has no tile offsets.
+bool parseTiff(const std::vector<uint8_t>& file, ParsedTiff& tiff) {
+	if (file.size() < 16 || file[0] != 'I' || file[1] != 'I') return false;
+	uint16_t version = loadLittleEndian16(file.data() + 2);
+	if (version != 42 && version != 43) return false;
+	tiff.big = version == 43;
+	if (tiff.big && (loadLittleEndian16(file.data() + 4) != 8 || loadLittleEndian16(file.data() + 6) != 0)) return false;
+	size_t word = tiff.big ? 8 : 4;
+	auto loadWord = [&](uint64_t offset) {
+		return tiff.big ? loadLittleEndian64(file.data() + offset) : loadLittleEndian32(file.data() + offset);
+	};
+	tiff.first_directory = loadWord(tiff.big ? 8 : 4);
+	for (uint64_t offset = tiff.first_directory; offset != 0; ) {
+		size_t count_size = tiff.big ? 8 : 2;
+		if (offset % 2 || offset + count_size > file.size()) return false;
+		uint64_t count = tiff.big ? loadLittleEndian64(file.data() + offset) : loadLittleEndian16(file.data() + offset);
+		size_t entry_size = 4 + 2 * word;
+		if (offset + count_size + count * entry_size + word > file.size()) return false;
+		Directory directory;
+		uint16_t last_tag = 0;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint64_t entry = offset + count_size + i * entry_size;
+			uint16_t tag = loadLittleEndian16(file.data() + entry);
+			uint16_t type = loadLittleEndian16(file.data() + entry + 2);
+			uint64_t n = loadWord(entry + 4);
+			// Entries must be sorted by tag.
+			if (tag <= last_tag) return false;
+			last_tag = tag;
+			size_t type_size;
+			switch (type) {
+			case 3: type_size = 2; break;
+			case 4: type_size = 4; break;
+			case 12: case 16: type_size = 8; break;
+			default: return false;
+			}
+			uint64_t value = entry + 4 + word;
+			if (n * type_size > word) value = loadWord(value);
+			if (value + n * type_size > file.size()) return false;
+			for (uint64_t k = 0; k < n; k++)
+			{
+				const uint8_t* p = file.data() + value + k * type_size;
+				if (type == 12) {
+					double d;
+					memcpy(&d, p, sizeof(d));
+					directory.doubles[tag].push_back(d);
+				}
+				else if (type == 3) directory.values[tag].push_back(loadLittleEndian16(p));
+				else if (type == 4) directory.values[tag].push_back(loadLittleEndian32(p));
+				else directory.values[tag].push_back(loadLittleEndian64(p));
+			}
+		}
+		if (!directory.values.count(324) || !directory.values.count(325)) return false;
+		tiff.directories.push_back(std::move(directory));
+		offset = loadWord(offset + count_size + count * entry_size);
+	}
+	return !tiff.directories.empty();
+}
+
+// Decodes tile index of directory into tile_size x tile_size floats,
+// undoing deflate and the floating-point predictor.
+bool readTile(const std::vector<uint8_t>& file, const Directory& directory, size_t index, std::vector<float>& tile) {
+	size_t tile_size = directory.value(322);
+	uint64_t offset = directory.values.at(324)[index];
+	uint64_t size = directory.values.at(325)[index];
+	if (offset + size > file.size()) return false;
+	size_t row_bytes = tile_size * sizeof(float);
+	tile.assign(tile_size * tile_size, 0.f);
+	if (directory.value(259) == 1) {
+		if (size != tile.size() * sizeof(float) || directory.value(317) != 1) return false;
+		memcpy(tile.data(), file.data() + offset, size);
+		return true;
+	}
+	std::vector<uint8_t> predicted;
+	if (directory.value(259) != 8 || directory.value(317) != 3) return false;
+	if (!inflateZlib(file.data() + offset, size, predicted) || predicted.size() != tile_size * row_bytes) return false;
+	for (size_t y = 0; y < tile_size; y++)
+	{
+		uint8_t* row = predicted.data() + y * row_bytes;
+		for (size_t i = 1; i < row_bytes; i++)
+		{
+			row[i] = (uint8_t)(row[i] + row[i - 1]);
+		}
+		uint8_t* out = (uint8_t*)(tile.data() + y * tile_size);
+		for (size_t i = 0; i < tile_size; i++)
+		{
+			for (size_t b = 0; b < sizeof(float); b++)
+			{
+				out[i * sizeof(float) + b] = row[(sizeof(float) - 1 - b) * tile_size + i];
+			}
+		}
+	}
+	return true;
+}
+
+// Reassembles the image of directory from its tiles. Returns false if a
+// tile fails to decode, overlaps the directories or carries non-zero
+// padding past the image edge.
+bool readImage(const std::vector<uint8_t>& file, const ParsedTiff& tiff, const Directory& directory, std::vector<float>& image) {
+	size_t width = directory.value(256);
+	size_t height = directory.value(257);
+	size_t tile_size = directory.value(322);
+	if (directory.value(323) != tile_size || tile_size == 0) return false;
+	size_t tiles_w = 1 + (width - 1) / tile_size;
+	size_t tiles_h = 1 + (height - 1) / tile_size;
+	if (directory.values.at(324).size() != tiles_w * tiles_h || directory.values.at(325).size() != tiles_w * tiles_h) return false;
+	image.assign(width * height, 0.f);
+	std::vector<float> tile;
+	for (size_t i = 0; i < tiles_w * tiles_h; i++)
+	{
+		// Tiles sit between the header and the directories.
+		uint64_t offset = directory.values.at(324)[i];
+		if (offset < (tiff.big ? 16u : 8u) || offset + directory.values.at(325)[i] > tiff.first_directory) return false;
+		if (!readTile(file, directory, i, tile)) return false;
+		size_t x0 = i % tiles_w * tile_size;
+		size_t y0 = i / tiles_w * tile_size;
+		for (size_t y = 0; y < tile_size; y++)
+		{
+			for (size_t x = 0; x < tile_size; x++)
+			{
+				float v = tile[y * tile_size + x];
+				if (x0 + x < width && y0 + y < height) image[(y0 + y) * width + x0 + x] = v;
+				else if (v != 0.f) return false;
+			}
+		}
+	}
+	return true;
+}
+
+// What the writer's overview of a width x height level should hold.
+std::vector<float> halve(const std::vector<float>& level, size_t width, size_t height) {
+	size_t out_w = (width + 1) / 2;
+	size_t out_h = (height + 1) / 2;
+	std::vector<float> out(out_w * out_h);
+	for (size_t y = 0; y < out_h; y++)
+	{
+		const float* top = level.data() + 2 * y * width;
+		const float* bottom = 2 * y + 1 < height ? top + width : top;
+		for (size_t x = 0; x < out_w; x++)
+		{
+			size_t x1 = std::min(2 * x + 1, width - 1);
+			out[y * out_w + x] = (top[2 * x] + top[x1] + bottom[2 * x] + bottom[x1]) * 0.25f;
+		}
+	}
+	return out;
+}
+
+// Tiles never overlap each other within or across directories.
+bool tilesDisjoint(const ParsedTiff& tiff) {
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	for (const Directory& directory : tiff.directories) {
+		for (size_t i = 0; i < directory.values.at(324).size(); i++)
+		{
+			ranges.push_back({ directory.values.at(324)[i], directory.values.at(325)[i] });
+		}
+	}
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); i++)
+	{
+		if (ranges[i - 1].first + ranges[i - 1].second > ranges[i].first) return false;
+	}
+	return true;
+}
+
+std::vector<float> testMap(size_t width, size_t height, ThreadPool& pool) {
+	std::vector<float> map(width * height);
+	generateMap(map.data(), width, height, 5, 0.5f, 2.f, 11, GradientSource::Hash, NoiseBackend::Perlin, pool);
+	return map;
+}
+
+// Writes map with options and checks every directory against it: tags,
+// georeferencing, tile layout and the decoded pixels of every level.
+void checkRoundTrip(const std::vector<float>& map, size_t width, size_t height, const TiffOptions& options, ThreadPool& pool, bool deflated) {
+	const std::string path = "tiff_test.tif";
+	CHECK(writeTiledTiff(path, map.data(), width, height, options, pool));
+	std::vector<uint8_t> file = readFile(path);
+	remove(path.c_str());
+	ParsedTiff tiff;
+	bool parsed = parseTiff(file, tiff);
+	CHECK(parsed);
+	if (!parsed) return;
+	CHECK(tiff.big == options.big_tiff);
+	CHECK(tilesDisjoint(tiff));
+
+	std::vector<float> expected = map;
+	size_t w = width;
+	size_t h = height;
+	for (size_t k = 0; k < tiff.directories.size(); k++)
+	{
+		const Directory& directory = tiff.directories[k];
+		CHECK(directory.value(254) == (k == 0 ? 0u : 1u));
+		CHECK(directory.value(256) == w && directory.value(257) == h);
+		CHECK(directory.value(258) == 32 && directory.value(339) == 3);
+		CHECK(directory.value(277) == 1 && directory.value(284) == 1);
+		CHECK(directory.value(259) == (deflated ? 8u : 1u));
+		CHECK(directory.value(317) == (deflated ? 3u : 1u));
+		CHECK(directory.value(322) == options.tile_size);
+		CHECK(directory.doubles.count(33550) == (k == 0 ? 1u : 0u));
+		if (k == 0) {
+			CHECK(directory.doubles.at(33550) == std::vector<double>({ 1, 1, 0 }));
+			CHECK(directory.doubles.at(33922) == std::vector<double>(6, 0.0));
+			CHECK(directory.values.at(34735).size() == 12);
+		}
+		std::vector<float> image;
+		CHECK(readImage(file, tiff, directory, image));
+		// Lossless, and the overviews match a 2x2 box filter exactly.
+		CHECK(image == expected);
+		expected = halve(expected, w, h);
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	// Levels stop once one fits a tile.
+	const Directory& last = tiff.directories.back();
+	CHECK(last.value(256) <= options.tile_size && last.value(257) <= options.tile_size);
+	CHECK(tiff.directories.size() == 1 || tiff.directories[tiff.directories.size() - 2].value(256) > options.tile_size
+		|| tiff.directories[tiff.directories.size() - 2].value(257) > options.tile_size);
+}
+
+}
+
+TEST(tiff, classic_tiff_round_trips_every_level) {
+	ThreadPool pool(4);
+	// Odd sizes so overviews round up and edge tiles are padded.
+	const size_t width = 301;
+	const size_t height = 167;
+	std::vector<float> map = testMap(width, height, pool);
+	TiffOptions options;
+	options.tile_size = 64;
+	checkRoundTrip(map, width, height, options, pool, DEFLATES);
+	options.deflate = false;
+	checkRoundTrip(map, width, height, options, pool, false);
+}
+
+TEST(tiff, big_tiff_round_trips_every_level) {
+	ThreadPool pool(4);
+	const size_t width = 250;
+	const size_t height = 333;
+	std::vector<float> map = testMap(width, height, pool);
+	TiffOptions options;
+	options.tile_size = 48;
+	options.big_tiff = true;
+	checkRoundTrip(map, width, height, options, pool, DEFLATES);
+	options.deflate = false;
+	checkRoundTrip(map, width, height, options, pool, false);
+}
+
+TEST(tiff, overviews_can_be_left_out) {
+	ThreadPool pool(2);
+	std::vector<float> map = testMap(100, 90, pool);
+	TiffOptions options;
+	options.tile_size = 32;
+	options.overviews = false;
+	CHECK(writeTiledTiff("tiff_test_single.tif", map.data(), 100, 90, options, pool));
+	ParsedTiff tiff;
+	CHECK(parseTiff(readFile("tiff_test_single.tif"), tiff));
+	remove("tiff_test_single.tif");
+	CHECK(tiff.directories.size() == 1);
+}
+
+TEST(tiff, generated_tiff_matches_the_generated_map) {
+	ThreadPool pool(4);
+	const size_t width = 200;
+	const size_t height = 130;
+	std::vector<float> map = testMap(width, height, pool);
+	TiffOptions options;
+	options.tile_size = 64;
+	CHECK(generateTiledTiff("tiff_test_generated.tif", width, height, 5, 0.5f, 2.f, 11, GradientSource::Hash, NoiseBackend::Perlin, options, pool));
+	std::vector<uint8_t> file = readFile("tiff_test_generated.tif");
+	remove("tiff_test_generated.tif");
+	ParsedTiff tiff;
+	bool parsed = parseTiff(file, tiff);
+	CHECK(parsed);
+	if (!parsed) return;
+	std::vector<float> image;
+	CHECK(readImage(file, tiff, tiff.directories[0], image));
+	bool close = image.size() == map.size();
+	for (size_t i = 0; close && i < map.size(); i++)
+	{
+		close = std::abs(image[i] - map[i]) < 1e-5f;
+	}
+	CHECK(close);
+}
+
+TEST(tiff, invalid_tile_sizes_are_rejected) {
+	ThreadPool pool(1);
+	std::vector<float> map(64 * 64, 0.f);
+	TiffOptions options;
+	options.tile_size = 40;
+	CHECK(!writeTiledTiff("tiff_test_invalid.tif", map.data(), 64, 64, options, pool));
+	options.tile_size = 0;
+	CHECK(!writeTiledTiff("tiff_test_invalid.tif", map.data(), 64, 64, options, pool));
+	remove("tiff_test_invalid.tif");
+}
@@ -0,0 +1,86 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+const size_t TILE_BYTES = CHUNK_SIZE * CHUNK_SIZE * sizeof(float);
+
+std::shared_ptr<const World> testWorld(uint32_t seed = 1) {
+	return std::make_shared<World>(3, 0.5f, 2.f, seed, NoiseBackend::Perlin, 512);
+}
+
+}
+
+TEST(tile_cache, hits_return_the_cached_tile) {
+	ThreadPool pool(2);
+	TileCache cache;
+	CHECK(cache.tile(0, 0, 0, pool) == nullptr);
+
+	std::shared_ptr<const World> world = testWorld();
+	cache.setWorld(world);
+	std::shared_ptr<const Tile> first = cache.tile(-3, 2, 1, pool);
+	CHECK(first != nullptr);
+	std::vector<float> expected(CHUNK_SIZE * CHUNK_SIZE);
+	world->generateTile(expected.data(), -3, 2, 1, pool);
+	CHECK(*first == expected);
+
+	CHECK(cache.tile(-3, 2, 1, pool) == first);
+	CHECK(cache.peek(-3, 2, 1) == first);
+	CHECK(cache.peek(-3, 2, 0) == nullptr);
+	TileCacheStats stats = cache.stats();
+	CHECK(stats.hits == 1 && stats.misses == 1);
+	CHECK(stats.tiles == 1 && stats.bytes == TILE_BYTES);
+}
+
+TEST(tile_cache, budget_evicts_least_recently_used) {
+	ThreadPool pool(2);
+	TileCache cache(3 * TILE_BYTES);
+	cache.setWorld(testWorld());
+	std::shared_ptr<const Tile> a = cache.tile(0, 0, 0, pool);
+	cache.tile(1, 0, 0, pool);
+	cache.tile(2, 0, 0, pool);
+	// Touching a makes (1, 0) the least recently used.
+	cache.tile(0, 0, 0, pool);
+	cache.tile(3, 0, 0, pool);
+	TileCacheStats stats = cache.stats();
+	CHECK(stats.tiles == 3 && stats.bytes <= stats.budget);
+	CHECK(stats.evictions == 1);
+	CHECK(cache.peek(1, 0, 0) == nullptr);
+	CHECK(cache.peek(0, 0, 0) == a);
+
+	// Lowering the budget evicts right away, and tiles handed out stay valid.
+	cache.setBudget(TILE_BYTES);
+	stats = cache.stats();
+	CHECK(stats.tiles == 1 && stats.evictions == 3);
+	CHECK(cache.peek(3, 0, 0) != nullptr);
+	CHECK(cache.peek(0, 0, 0) == nullptr);
+	CHECK(a->size() == CHUNK_SIZE * CHUNK_SIZE);
+
+	cache.setBudget(0);
+	CHECK(cache.stats().tiles == 0);
+	CHECK(cache.tile(4, 0, 0, pool) != nullptr);
+	CHECK(cache.stats().tiles == 0);
+}
+
+TEST(tile_cache, new_world_drops_tiles) {
+	ThreadPool pool(2);
+	TileCache cache;
+	cache.setWorld(testWorld(1));
+	std::shared_ptr<const Tile> old_tile = cache.tile(0, 0, 0, pool);
+	cache.setWorld(testWorld(2));
+	CHECK(cache.stats().tiles == 0);
+	CHECK(*cache.tile(0, 0, 0, pool) != *old_tile);
+}
+
+TEST(tile_cache, cancelled_tiles_are_not_cached) {
+	ThreadPool pool(2);
+	TileCache cache;
+	cache.setWorld(testWorld());
+	CancellationToken cancel;
+	cancel.cancel();
+	CHECK(cache.tile(0, 0, 0, pool, &cancel) == nullptr);
+	CHECK(cache.stats().tiles == 0);
+}
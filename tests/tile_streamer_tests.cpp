@@ -0,0 +1,125 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Waits until the streamer has nothing left to do. Returns false on
+// timeout.
+bool waitIdle(const TileStreamer& streamer) {
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (streamer.pending() > 0) {
+		if (std::chrono::steady_clock::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+}
+
+TEST(tile_streamer, lod_follows_zoom) {
+	CHECK(lodForZoom(4) == 0);
+	CHECK(lodForZoom(1) == 0);
+	CHECK(lodForZoom(0.5) == 1);
+	CHECK(lodForZoom(0.3) == 1);
+	CHECK(lodForZoom(0.25) == 2);
+	CHECK(lodForZoom(1e-9) == MAX_LOD);
+}
+
+TEST(tile_streamer, coarser_tile_rounds_down) {
+	CHECK(coarserTile(5, 1) == 2);
+	CHECK(coarserTile(4, 2) == 1);
+	CHECK(coarserTile(0, 3) == 0);
+	CHECK(coarserTile(-1, 1) == -1);
+	CHECK(coarserTile(-2, 1) == -1);
+	CHECK(coarserTile(-3, 1) == -2);
+	CHECK(coarserTile(-9, 2) == -3);
+}
+
+TEST(tile_streamer, tiles_cover_the_view_nearest_first) {
+	double extent = (double)World::tileExtent(0);
+	Viewport view{ -extent / 2, -extent / 2, extent, extent, 1 };
+	std::vector<TileKey> tiles = tilesToStream(view, 0, 0);
+	// The view straddles the origin, so it touches four tiles.
+	CHECK(tiles.size() == 4);
+
+	tiles = tilesToStream(view, 0, 1);
+	CHECK(tiles.size() == 16);
+	// The four tiles around the centre come before the margin.
+	for (size_t i = 0; i < 4; i++)
+	{
+		CHECK(tiles[i].cx >= -1 && tiles[i].cx <= 0 && tiles[i].cy >= -1 && tiles[i].cy <= 0);
+	}
+	for (const TileKey& key : tiles) {
+		CHECK(key.lod == 0);
+	}
+}
+
+TEST(tile_streamer, streams_colored_tiles) {
+	ThreadPool pool(2);
+	TileCache cache;
+	auto world = std::make_shared<World>(3, 0.5f, 2.f, 5, NoiseBackend::Perlin, 512);
+	cache.setWorld(world);
+	TileStreamer streamer(cache, pool);
+	std::vector<TileKey> keys = { { 0, 0, 0 }, { -1, 2, 3 } };
+	streamer.request(keys);
+	CHECK(waitIdle(streamer));
+	std::vector<TileStreamer::Ready> ready = streamer.takeReady(16);
+	CHECK(ready.size() == 2);
+	for (size_t i = 0; i < ready.size() && i < keys.size(); i++)
+	{
+		CHECK(ready[i].key == keys[i]);
+		std::vector<float> heights(CHUNK_SIZE * CHUNK_SIZE);
+		world->generateTile(heights.data(), keys[i].cx, keys[i].cy, keys[i].lod, pool);
+		std::vector<uint8_t> pixels(CHUNK_SIZE * CHUNK_SIZE * 4);
+		mapToPixels(heights.data(), CHUNK_SIZE, CHUNK_SIZE, pixels.data(), CHUNK_SIZE);
+		CHECK(ready[i].pixels == pixels);
+	}
+	CHECK(streamer.takeReady(16).empty());
+}
+
+TEST(tile_streamer, reset_cancels_the_tile_being_generated) {
+	ThreadPool pool(1);
+	TileCache cache;
+	// Enough octaves that one tile takes long enough to be caught mid-way.
+	cache.setWorld(std::make_shared<World>(256, 0.5f, 2.f, 5, NoiseBackend::Perlin, 512));
+	TileStreamer streamer(cache, pool);
+	streamer.request({ { 0, 0, 0 }, { 1, 0, 0 } });
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+	while (cache.stats().misses == 0 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+	streamer.reset();
+	CHECK(waitIdle(streamer));
+	CHECK(streamer.takeReady(16).empty());
+	// The cancelled tile was never finished, so it isn't cached either, and
+	// the second tile was never started.
+	TileCacheStats stats = cache.stats();
+	CHECK(stats.misses == 1);
+	CHECK(stats.tiles == 0);
+}
+
+TEST(tile_streamer, atlas_reuses_the_least_recently_used_slot) {
+	TileAtlas atlas(2, 1);
+	size_t a = atlas.insert({ 0, 0, 0 });
+	size_t b = atlas.insert({ 1, 0, 0 });
+	CHECK(a != b);
+	CHECK(atlas.insert({ 0, 0, 0 }) == a);
+	CHECK(atlas.slotX(b) == CHUNK_SIZE && atlas.slotY(b) == 0);
+
+	// (0, 0) was used last, so (1, 0) gives up its slot.
+	size_t slot;
+	CHECK(atlas.find({ 0, 0, 0 }, slot) && slot == a);
+	CHECK(atlas.insert({ 2, 0, 0 }) == b);
+	CHECK(!atlas.find({ 1, 0, 0 }, slot));
+	CHECK(atlas.find({ 2, 0, 0 }, slot) && slot == b);
+
+	atlas.clear();
+	CHECK(!atlas.find({ 0, 0, 0 }, slot));
+	CHECK(!atlas.find({ 2, 0, 0 }, slot));
+}
@@ -0,0 +1,108 @@
+#include "test.h"
+#include "worldgen.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const size_t SCALE = 2 * CHUNK_SIZE;
+
+std::vector<float> worldTile(const World& world, int64_t cx, int64_t cy, unsigned lod, ThreadPool& pool) {
+	std::vector<float> tile(CHUNK_SIZE * CHUNK_SIZE);
+	world.generateTile(tile.data(), cx, cy, lod, pool);
+	return tile;
+}
+
+}
+
+TEST(world, tiles_join_into_generate_map) {
+	ThreadPool pool(2);
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		NoiseBackend noise = (NoiseBackend)i;
+		World world(6, 0.5f, 2.f, 17, noise, SCALE);
+		std::vector<float> map(SCALE * SCALE);
+		generateMap(map.data(), SCALE, SCALE, 6, 0.5f, 2.f, 17, GradientSource::Hash, noise, pool);
+
+		bool same = true;
+		for (int64_t cy = 0; cy < 2; cy++)
+		{
+			for (int64_t cx = 0; cx < 2; cx++)
+			{
+				std::vector<float> tile = worldTile(world, cx, cy, 0, pool);
+				for (size_t y = 0; y < CHUNK_SIZE; y++)
+				{
+					for (size_t x = 0; x < CHUNK_SIZE; x++)
+					{
+						same = same && tile[y * CHUNK_SIZE + x] == map[(cy * CHUNK_SIZE + y) * SCALE + cx * CHUNK_SIZE + x];
+					}
+				}
+			}
+		}
+		CHECK(same);
+	}
+}
+
+TEST(world, coarser_tiles_sample_the_finer_ones) {
+	ThreadPool pool(2);
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		World world(5, 0.5f, 2.f, 4, (NoiseBackend)i, SCALE);
+		// Includes tiles left of and above the origin.
+		for (int64_t coarse_cy : { -1, 0 }) {
+			for (int64_t coarse_cx : { -1, 0, 1 }) {
+				std::vector<float> coarse = worldTile(world, coarse_cx, coarse_cy, 1, pool);
+				bool same = true;
+				for (int64_t dy = 0; dy < 2; dy++)
+				{
+					for (int64_t dx = 0; dx < 2; dx++)
+					{
+						std::vector<float> fine = worldTile(world, coarse_cx * 2 + dx, coarse_cy * 2 + dy, 0, pool);
+						for (size_t y = 0; y < CHUNK_SIZE; y += 2)
+						{
+							for (size_t x = 0; x < CHUNK_SIZE; x += 2)
+							{
+								size_t cx = dx * CHUNK_SIZE / 2 + x / 2;
+								size_t cy = dy * CHUNK_SIZE / 2 + y / 2;
+								same = same && coarse[cy * CHUNK_SIZE + cx] == fine[y * CHUNK_SIZE + x];
+							}
+						}
+					}
+				}
+				CHECK(same);
+			}
+		}
+	}
+}
+
+TEST(world, tiles_are_continuous_across_the_origin) {
+	ThreadPool pool(2);
+	World world(1, 0.5f, 2.f, 8, NoiseBackend::Perlin, SCALE);
+	std::vector<float> left = worldTile(world, -1, 0, 0, pool);
+	std::vector<float> right = worldTile(world, 0, 0, 0, pool);
+	// Neighbouring samples of one smooth octave differ by little more than
+	// its slope; a seam would jump by up to the octave's full range.
+	float max_step = 0;
+	float max_seam = 0;
+	for (size_t y = 0; y < CHUNK_SIZE; y++)
+	{
+		const float* row = left.data() + y * CHUNK_SIZE;
+		for (size_t x = 1; x < CHUNK_SIZE; x++)
+		{
+			max_step = std::max(max_step, std::abs(row[x] - row[x - 1]));
+		}
+		max_seam = std::max(max_seam, std::abs(right[y * CHUNK_SIZE] - row[CHUNK_SIZE - 1]));
+	}
+	CHECK(max_step > 0);
+	CHECK(max_seam <= max_step * 1.5f);
+}
+
+TEST(world, cancelled_tile_returns_false) {
+	ThreadPool pool(2);
+	World world(3, 0.5f, 2.f, 1, NoiseBackend::Perlin, SCALE);
+	std::vector<float> tile(CHUNK_SIZE * CHUNK_SIZE);
+	CancellationToken cancel;
+	cancel.cancel();
+	CHECK(!world.generateTile(tile.data(), 0, 0, 0, pool, &cancel));
+}
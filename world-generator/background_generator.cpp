@@ -0,0 +1,183 @@
+#include "background_generator.h"
+#include "colorize.h"
+
+#include <limits>
+
+// More rects than this waiting for takeResult are merged into one for the
+// whole map.
+const size_t MAX_DIRTY_RECTS = 256;
+
+BackgroundGenerator::BackgroundGenerator(size_t width, size_t height, ThreadPool& pool)
+	: m_width(width), m_height(height), m_pool(pool), m_map(width * height), m_pixels(width * height * 4), m_cache(width, height) {
+	// NaN never compares equal byte for byte to generated heights, so the
+	// first result is dirty everywhere.
+	m_shown.assign(width * height, std::numeric_limits<float>::quiet_NaN());
+	m_shown_pixels.assign(width * height * 4, 0);
+	m_worker = std::thread(&BackgroundGenerator::workerLoop, this);
+}
+
+BackgroundGenerator::~BackgroundGenerator() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_cancel.cancel();
+	}
+	m_cv.notify_all();
+	m_worker.join();
+}
+
+void BackgroundGenerator::request(const MapParams& params) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_params = params;
+		m_pending = true;
+		m_cancel.cancel();
+	}
+	m_cv.notify_all();
+}
+
+void BackgroundGenerator::setColormap(std::shared_ptr<const Colormap> colormap) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_colormap = std::move(colormap);
+		m_style++;
+		m_recolor = true;
+	}
+	m_cv.notify_all();
+}
+
+void BackgroundGenerator::setHillshade(bool enabled, const Hillshade& shade) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shaded = enabled;
+		m_hillshade = shade;
+		m_style++;
+		m_recolor = true;
+	}
+	m_cv.notify_all();
+}
+
+bool BackgroundGenerator::takeResult(std::vector<float>& map, std::vector<uint8_t>& pixels, std::vector<DirtyRect>& dirty) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_published) return false;
+	if (map.empty() || pixels.empty()) {
+		map = m_map;
+		pixels = m_pixels;
+		dirty.assign(1, DirtyRect{ 0, 0, m_width, m_height });
+		m_dirty.clear();
+		return true;
+	}
+	if (m_dirty.empty()) return false;
+	for (const DirtyRect& rect : m_dirty) {
+		copyRect(m_map.data(), map.data(), m_width, rect);
+		copyRect(m_pixels.data(), pixels.data(), m_width, rect, 4);
+	}
+	dirty.swap(m_dirty);
+	m_dirty.clear();
+	return true;
+}
+
+bool BackgroundGenerator::busy() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pending || m_recolor || m_running;
+}
+
+void BackgroundGenerator::publish(const std::vector<float>& map) {
+	std::shared_ptr<const Colormap> colormap;
+	bool shaded;
+	Hillshade shade;
+	size_t style;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pending) return;
+		colormap = m_colormap;
+		shaded = m_shaded;
+		shade = m_hillshade;
+		style = m_style;
+	}
+	std::vector<DirtyRect> rects;
+	if (style != m_shown_style) {
+		rects.push_back({ 0, 0, m_width, m_height });
+		m_shown_style = style;
+	}
+	else {
+		rects = diffMaps(m_shown.data(), map.data(), m_width, m_height, TILE_SIZE);
+	}
+	if (&map != &m_shown) {
+		for (const DirtyRect& rect : rects) {
+			copyRect(map.data(), m_shown.data(), m_width, rect);
+		}
+	}
+	// A shaded pixel depends on its neighbours, so the ring around every
+	// changed rect is redone too. Each rect is colorized right before it is
+	// shaded, so overlapping rings are never shaded twice.
+	for (DirtyRect& rect : rects) {
+		if (shaded) rect = hillshadeHalo(rect, m_width, m_height);
+		mapRectToPixels(m_shown.data(), m_width, rect, m_shown_pixels.data(), m_width, colormap.get());
+		if (shaded) hillshadeRect(m_shown.data(), m_width, m_height, rect, shade, m_shown_pixels.data(), m_width, m_pool);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_published = true;
+	for (const DirtyRect& rect : rects) {
+		copyRect(m_shown.data(), m_map.data(), m_width, rect);
+		copyRect(m_shown_pixels.data(), m_pixels.data(), m_width, rect, 4);
+	}
+	m_dirty.insert(m_dirty.end(), rects.begin(), rects.end());
+	if (m_dirty.size() > MAX_DIRTY_RECTS) {
+		m_dirty.assign(1, DirtyRect{ 0, 0, m_width, m_height });
+	}
+}
+
+void BackgroundGenerator::workerLoop() {
+	std::vector<float> map(m_width * m_height);
+	std::vector<float> preview(m_width * m_height);
+	auto show_level = [&](const float* level, size_t step) {
+		expandLevel(level, step, preview.data(), m_width, m_height);
+		publish(preview);
+	};
+
+	while (true) {
+		MapParams params;
+		bool generate;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_stop || m_pending || m_recolor; });
+			if (m_stop) return;
+			params = m_params;
+			generate = m_pending;
+			m_pending = false;
+			m_recolor = false;
+			m_running = true;
+			m_cancel.reset();
+		}
+
+		if (!generate) {
+			// Only the colormap changed, so the shown map is published again.
+			if (m_published) publish(m_shown);
+		}
+		else {
+			// The previews stop at step 2 and the full map is only computed
+			// by the cache, a layer at a time. The step 2 samples are computed
+			// again there, since the cache keeps each layer rather than the
+			// sum the preview holds; that is a quarter of the map's samples,
+			// traded for re-sums on later changes. One bar covers the previews
+			// and the layers.
+			bool previews = m_cache.missingLayers(params.octaves, params.lacunarity, params.seed, params.source, params.noise) > 0;
+			m_progress.done = 0;
+			m_progress.total = m_cache.progressTiles(params.octaves, params.lacunarity, params.seed, params.source, params.noise) + (previews ? previewTiles(m_width, m_height) : 0);
+			bool done = true;
+			if (previews) {
+				std::vector<Octave> layers;
+				std::vector<float> finest;
+				done = mapOctaves(layers, m_width, m_height, params.octaves, params.persistence, params.lacunarity, params.seed, params.source, params.noise, &m_cancel)
+					&& generatePreviews(finest, layers, m_width, m_height, m_pool, show_level, &m_progress, &m_cancel);
+			}
+			done = done && m_cache.generate(map.data(), params.octaves, params.persistence, params.lacunarity, params.seed, params.source, params.noise, m_pool, &m_progress, &m_cancel);
+			if (done) publish(map);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "colormap.h"
+#include "dirty_rect.h"
+#include "hillshade.h"
+#include "octave_cache.h"
+#include "progressive.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything generateMap needs apart from the map size.
+struct MapParams {
+	size_t octaves = 1;
+	float persistence = 0.5f;
+	float lacunarity = 2.0f;
+	uint32_t seed = 0;
+	GradientSource source = GradientSource::Grid;
+	NoiseBackend noise = NoiseBackend::Perlin;
+};
+
+// Generates and colorizes maps on its own thread so the caller never waits
+// for a generation. Only the newest request is kept: a request made while
+// another is running cancels it and replaces any that hasn't started yet.
+// Octave layers are cached between requests, so a change that only needs
+// cached layers is a quick re-sum. Otherwise coarse previews of the map are
+// handed out while the missing layers are computed. Unlike
+// generateMapProgressive the full map doesn't reuse the finest preview: the
+// cache needs every layer at every pixel, and a preview only holds their sum.
+class BackgroundGenerator {
+public:
+	BackgroundGenerator(size_t width, size_t height, ThreadPool& pool);
+	~BackgroundGenerator();
+
+	BackgroundGenerator(const BackgroundGenerator&) = delete;
+	BackgroundGenerator& operator=(const BackgroundGenerator&) = delete;
+
+	void request(const MapParams& params);
+
+	// Colors the shown map and every later one through colormap, or as
+	// grayscale if it is null. The shown map is recolored without being
+	// generated again.
+	void setColormap(std::shared_ptr<const Colormap> colormap);
+
+	// Turns hillshading of the colored map on or off, also without
+	// generating it again.
+	void setHillshade(bool enabled, const Hillshade& shade);
+
+	// Brings map and pixels up to date with the newest finished map or
+	// preview, RGBA with alpha 255, and sets dirty to the rects that changed
+	// since the last call. Only those rects are copied, unless map or
+	// pixels is empty, e.g. on the first call or after the caller moved
+	// them out. Then both are filled entirely and dirty covers the whole
+	// map. Returns false, leaving everything untouched, if nothing changed.
+	bool takeResult(std::vector<float>& map, std::vector<uint8_t>& pixels, std::vector<DirtyRect>& dirty);
+
+	// True while a request or a recolor is pending or running.
+	bool busy() const;
+
+	// Progress of the running generation in [0, 1].
+	float progress() const { return m_progress.fraction(); }
+
+private:
+	void workerLoop();
+
+	// Makes map the next result unless a newer request is waiting. Only the
+	// tiles that differ from the last result are colorized and handed on,
+	// unless the colormap or hillshading changed since.
+	void publish(const std::vector<float>& map);
+
+	size_t m_width;
+	size_t m_height;
+	ThreadPool& m_pool;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	bool m_pending = false;
+	bool m_running = false;
+	bool m_recolor = false;
+	MapParams m_params;
+	std::shared_ptr<const Colormap> m_colormap;
+	bool m_shaded = false;
+	Hillshade m_hillshade;
+	// Bumped whenever the colormap or hillshading changes.
+	size_t m_style = 0;
+	// Newest result and the rects of it not taken yet. m_published is
+	// only written by the worker.
+	bool m_published = false;
+	std::vector<float> m_map;
+	std::vector<uint8_t> m_pixels;
+	std::vector<DirtyRect> m_dirty;
+
+	// Only used by the worker thread. m_shown is the last published map.
+	OctaveCache m_cache;
+	std::vector<float> m_shown;
+	std::vector<uint8_t> m_shown_pixels;
+	size_t m_shown_style = 0;
+	GenerationProgress m_progress;
+	CancellationToken m_cancel;
+	std::thread m_worker;
+};
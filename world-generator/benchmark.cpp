@@ -0,0 +1,322 @@
+#include "benchmark.h"
+#include "colorize.h"
+#include "hillshade.h"
+#include "generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace {
+
+const size_t OPTIMAL_THREAD_NUM = 128;
+const size_t REPEATS = 5;
+const float KERNEL_TOLERANCE = 1e-6f;
+const uint32_t SEED = 1;
+
+// Fills Perlin cells off to off + n of the map, the unit of work one
+// spawned thread got.
+void perlin_process_blocks(float* map, size_t map_width, size_t map_height, const GradientField& gradients, size_t size, size_t off, size_t n) {
+	PerlinSpanKernel kernel = perlinSpanKernel(detectSimdLevel());
+	size_t grid_cell_w = 1 + (map_width - 1) / size;
+	for (size_t i = 0; i < n; i++)
+	{
+		size_t block_offset_x = (off + i) % grid_cell_w;
+		size_t block_offset_y = (off + i) / grid_cell_w;
+		size_t width = std::min(size, map_width - (block_offset_x) * size);
+		size_t height = std::min(size, map_height - (block_offset_y) * size);
+		size_t x0 = block_offset_x * size;
+		size_t y0 = block_offset_y * size;
+		perlin_process_rect(map + y0 * map_width + x0, map_width, gradients, size, x0, y0, width, height, kernel);
+	}
+}
+
+// Reference for the spawn-per-call path the pool replaced: every octave
+// creates and joins up to OPTIMAL_THREAD_NUM threads.
+void perlinNoiseSpawn(float* map, size_t width, size_t height, size_t grid_cell_size, uint32_t seed) {
+	size_t grid_cell_w = 1 + (width - 1) / grid_cell_size;
+	size_t grid_cell_h = 1 + (height - 1) / grid_cell_size;
+	GradientField gradients(GradientSource::Grid, seed, grid_cell_w + 1, grid_cell_h + 1);
+
+	size_t blocks_n = grid_cell_h * grid_cell_w;
+	size_t block_per_thread = blocks_n / OPTIMAL_THREAD_NUM;
+	size_t last_thread_blocks = blocks_n - block_per_thread * OPTIMAL_THREAD_NUM;
+	size_t threads_n = block_per_thread == 0 ? 0 : OPTIMAL_THREAD_NUM;
+
+	std::vector<std::thread> threads(threads_n);
+	for (size_t i = 0; i < threads_n; i++)
+	{
+		size_t off = i * block_per_thread;
+		threads[i] = std::thread(perlin_process_blocks, map, width, height, std::cref(gradients), grid_cell_size, off, block_per_thread);
+	}
+	if (last_thread_blocks != 0) {
+		size_t off = blocks_n - last_thread_blocks;
+		perlin_process_blocks(map, width, height, gradients, grid_cell_size, off, last_thread_blocks);
+	}
+	std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+}
+
+void generateMapSpawn(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity) {
+	float frequency = 2;
+	float amplitude = 0.5;
+	std::vector<float> temp_map(width * height);
+	memset(map, 0, sizeof(float) * width * height);
+
+	for (size_t i = 0; i < octaves; i++) {
+		frequency *= lacunarity;
+		amplitude *= persistence;
+		perlinNoiseSpawn(temp_map.data(), width, height, std::max(1.f, width / frequency), octaveSeed(SEED, i));
+		for (size_t j = 0; j < width * height; j++)
+		{
+			map[j] += temp_map[j] * amplitude;
+		}
+	}
+}
+
+// Best of repeats runs, in milliseconds.
+double timeBest(const std::function<void()>& fn, size_t repeats = REPEATS) {
+	double best = 0;
+	for (size_t i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (i == 0 || elapsed.count() < best) best = elapsed.count();
+	}
+	return best;
+}
+
+void fillWithKernel(float* map, size_t width, size_t height, size_t size, const GradientField& gradients, const NoiseBackendOps& backend, SimdLevel level) {
+	backend.process_rect(map, width, gradients, size, 0, 0, width, height, level, 1);
+}
+
+// Every SIMD kernel of every backend this CPU can run must match the
+// scalar one. Returns false if any of them is off by more than
+// KERNEL_TOLERANCE.
+bool checkKernels(size_t width, size_t height) {
+	bool ok = true;
+	std::vector<float> expected(width * height);
+	std::vector<float> actual(width * height);
+	printf("%8s %8s %10s %14s %14s\n", "noise", "kernel", "cell size", "max error", "ms");
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		const NoiseBackendOps& backend = noiseBackend((NoiseBackend)i);
+		for (size_t size : { 1, 7, 64, 318 }) {
+			size_t grid_w = 1 + (width - 1) / size + 1;
+			size_t grid_h = 1 + (height - 1) / size + 1;
+			size_t padding = backend.lattice_padding(grid_w, grid_h);
+			GradientField gradients(GradientSource::Grid, SEED, grid_w + padding, grid_h + padding);
+			fillWithKernel(expected.data(), width, height, size, gradients, backend, SimdLevel::Scalar);
+			for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 }) {
+				if (level > detectSimdLevel()) continue;
+				double ms = timeBest([&]() { fillWithKernel(actual.data(), width, height, size, gradients, backend, level); });
+				float max_error = 0;
+				for (size_t j = 0; j < width * height; j++)
+				{
+					max_error = std::max(max_error, std::abs(actual[j] - expected[j]));
+				}
+				ok = ok && max_error <= KERNEL_TOLERANCE;
+				printf("%8s %8s %10zu %14g %14.3f\n", backend.name, simdLevelName(level), size, max_error, ms);
+			}
+		}
+	}
+	return ok;
+}
+
+// Same as checkKernels for the colorize and colormap kernels, which must
+// match exactly.
+bool checkColorizeKernels(size_t width, size_t height) {
+	bool ok = true;
+	std::vector<float> map(width * height);
+	GradientField gradients(GradientSource::Grid, SEED, 1 + (width - 1) / 64 + 1, 1 + (height - 1) / 64 + 1);
+	fillWithKernel(map.data(), width, height, 64, gradients, noiseBackend(NoiseBackend::Perlin), SimdLevel::Scalar);
+	std::vector<uint8_t> expected(width * height * 4);
+	std::vector<uint8_t> actual(width * height * 4);
+	colorizeKernel(SimdLevel::Scalar)(map.data(), width * height, expected.data());
+	printf("%8s %14s %14s\n", "colorize", "mismatches", "ms");
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 }) {
+		if (level > detectSimdLevel()) continue;
+		double ms = timeBest([&]() { colorizeKernel(level)(map.data(), width * height, actual.data()); });
+		size_t mismatches = 0;
+		for (size_t i = 0; i < actual.size(); i++)
+		{
+			mismatches += actual[i] != expected[i];
+		}
+		ok = ok && mismatches == 0;
+		printf("%8s %14zu %14.3f\n", simdLevelName(level), mismatches, ms);
+	}
+
+	Colormap colormap(biomeStops());
+	colormapKernel(SimdLevel::Scalar)(map.data(), width * height, colormap.lut(), expected.data());
+	printf("%8s %14s %14s\n", "colormap", "mismatches", "ms");
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 }) {
+		if (level > detectSimdLevel()) continue;
+		double ms = timeBest([&]() { colormapKernel(level)(map.data(), width * height, colormap.lut(), actual.data()); });
+		size_t mismatches = 0;
+		for (size_t i = 0; i < actual.size(); i++)
+		{
+			mismatches += actual[i] != expected[i];
+		}
+		ok = ok && mismatches == 0;
+		printf("%8s %14zu %14.3f\n", simdLevelName(level), mismatches, ms);
+	}
+	return ok;
+}
+
+// One timed stage of the suite. Parameters that don't apply to the stage
+// are 0.
+struct SuiteResult {
+	const char* stage;
+	size_t size;
+	size_t octaves;
+	size_t cell_size;
+	size_t threads;
+	// Bytes of map and pixel memory the stage reads and writes per pixel,
+	// or 0 for generation, which only writes its output.
+	size_t bytes_per_pixel;
+	double ms;
+
+	double nsPerPixel() const { return ms * 1e6 / ((double)size * size); }
+	double gbPerSecond() const { return (double)size * size * bytes_per_pixel / (ms * 1e6); }
+};
+
+std::string resultName(const SuiteResult& r) {
+	std::string name = std::string(r.stage) + "/size:" + std::to_string(r.size);
+	if (r.octaves != 0) name += "/octaves:" + std::to_string(r.octaves);
+	if (r.cell_size != 0) name += "/cell:" + std::to_string(r.cell_size);
+	if (r.threads != 0) name += "/threads:" + std::to_string(r.threads);
+	return name;
+}
+
+void printResult(const SuiteResult& r) {
+	printf("%-48s %12.3f %10.3f ", resultName(r).c_str(), r.ms, r.nsPerPixel());
+	if (r.bytes_per_pixel == 0) printf("%8s\n", "-");
+	else printf("%8.2f\n", r.gbPerSecond());
+}
+
+bool writeSuiteJson(const std::string& path, const BenchmarkSuite& suite, const std::vector<SuiteResult>& results) {
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) return false;
+	fprintf(file, "{\n  \"context\": {\n");
+	fprintf(file, "    \"simd\": \"%s\",\n", simdLevelName(detectSimdLevel()));
+	fprintf(file, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "    \"gradients\": \"%s\",\n", suite.gradients == GradientSource::Hash ? "hash" : "grid");
+	fprintf(file, "    \"repeats\": %zu\n  },\n  \"benchmarks\": [\n", suite.repeats);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SuiteResult& r = results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"stage\": \"%s\", \"size\": %zu, \"octaves\": %zu, \"cell_size\": %zu, \"threads\": %zu, "
+			"\"ms\": %.6f, \"ns_per_pixel\": %.6f",
+			resultName(r).c_str(), r.stage, r.size, r.octaves, r.cell_size, r.threads, r.ms, r.nsPerPixel());
+		if (r.bytes_per_pixel != 0) fprintf(file, ", \"gb_per_s\": %.6f", r.gbPerSecond());
+		fprintf(file, " }%s\n", i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	return fclose(file) == 0;
+}
+
+}
+
+int checkSimdKernels(size_t width, size_t height) {
+	printf("single-threaded noise kernels, %s selected\n", simdLevelName(detectSimdLevel()));
+	if (!checkKernels(width, height)) {
+		printf("SIMD kernel output differs from the scalar kernel by more than %g\n", KERNEL_TOLERANCE);
+		return 1;
+	}
+	if (!checkColorizeKernels(width, height)) {
+		printf("SIMD colorize kernel output differs from the scalar kernel\n");
+		return 1;
+	}
+	return 0;
+}
+
+int runBenchmark(ThreadPool& pool, size_t width, size_t height) {
+	std::vector<float> map(width * height);
+	const float persistence = 0.5f;
+	const float lacunarity = 2.0f;
+
+	if (checkSimdKernels(width, height) != 0) return 1;
+
+	printf("map %zux%zu, pool of %zu threads, best of %zu runs\n", width, height, pool.size(), REPEATS);
+	printf("%8s %14s %14s %9s %14s\n", "octaves", "spawn ms", "pool ms", "speedup", "hashed ms");
+	for (size_t octaves : { 1, 4, 8, 16 }) {
+		double spawn = timeBest([&]() { generateMapSpawn(map.data(), width, height, octaves, persistence, lacunarity); });
+		double pooled = timeBest([&]() { generateMap(map.data(), width, height, octaves, persistence, lacunarity, SEED, GradientSource::Grid, NoiseBackend::Perlin, pool); });
+		double hashed = timeBest([&]() { generateMap(map.data(), width, height, octaves, persistence, lacunarity, SEED, GradientSource::Hash, NoiseBackend::Perlin, pool); });
+		printf("%8zu %14.3f %14.3f %8.2fx %14.3f\n", octaves, spawn, pooled, spawn / pooled, hashed);
+	}
+	return 0;
+}
+
+int runBenchmarkSuite(const BenchmarkSuite& suite) {
+	const float persistence = 0.5f;
+	const float lacunarity = 2.0f;
+	std::vector<std::unique_ptr<ThreadPool>> pools;
+	for (size_t threads_n : suite.threads) {
+		pools.push_back(std::make_unique<ThreadPool>(threads_n));
+	}
+
+	printf("%s kernels, best of %zu runs\n", simdLevelName(detectSimdLevel()), suite.repeats);
+	printf("%-48s %12s %10s %8s\n", "benchmark", "ms", "ns/pixel", "GB/s");
+	std::vector<SuiteResult> results;
+	auto record = [&](const SuiteResult& r) {
+		results.push_back(r);
+		printResult(r);
+	};
+	for (size_t size : suite.sizes) {
+		std::vector<float> map(size * size);
+		for (size_t i = 0; i < pools.size(); i++)
+		{
+			ThreadPool& pool = *pools[i];
+			for (size_t octaves : suite.octaves) {
+				double ms = timeBest([&]() { generateMap(map.data(), size, size, octaves, persistence, lacunarity, SEED, suite.gradients, NoiseBackend::Perlin, pool); }, suite.repeats);
+				record({ "generateMap", size, octaves, 0, suite.threads[i], 0, ms });
+			}
+			for (size_t cell_size : suite.cell_sizes) {
+				double ms = timeBest([&]() { perlinNoise(map.data(), size, size, cell_size, SEED, suite.gradients, pool); }, suite.repeats);
+				record({ "perlinNoise", size, 0, cell_size, suite.threads[i], 0, ms });
+				ms = timeBest([&]() { noiseLayer(map.data(), size, size, cell_size, SEED, suite.gradients, NoiseBackend::Simplex, pool); }, suite.repeats);
+				record({ "simplexNoise", size, 0, cell_size, suite.threads[i], 0, ms });
+			}
+		}
+	}
+	for (size_t size : suite.colorize_sizes) {
+		std::vector<float> map(size * size);
+		std::vector<uint8_t> pixels(size * size * 4);
+		perlinNoise(map.data(), size, size, suite.cell_sizes[0], SEED, suite.gradients, *pools[0]);
+		double ms = timeBest([&]() { mapToPixels(map.data(), size, size, pixels.data(), size); }, suite.repeats);
+		record({ "mapToPixels", size, 0, 0, 0, sizeof(float) + 4, ms });
+		for (size_t i = 0; i < pools.size(); i++)
+		{
+			ms = timeBest([&]() { mapToPixels(map.data(), size, size, pixels.data(), size, *pools[i]); }, suite.repeats);
+			record({ "mapToPixels", size, 0, 0, suite.threads[i], sizeof(float) + 4, ms });
+		}
+		CompactHeightfield compact(size, size, HeightEncoding::Uint16);
+		compact.encode(map.data(), 0, map.size());
+		for (size_t i = 0; i < pools.size(); i++)
+		{
+			ms = timeBest([&]() { mapToPixels(compact, pixels.data(), size, *pools[i]); }, suite.repeats);
+			record({ "mapToPixelsCompact", size, 0, 0, suite.threads[i], sizeof(uint16_t) + 4, ms });
+		}
+		Colormap colormap(biomeStops());
+		ms = timeBest([&]() { mapToPixels(map.data(), size, size, pixels.data(), size, &colormap); }, suite.repeats);
+		record({ "mapToPixelsColormap", size, 0, 0, 0, sizeof(float) + 4, ms });
+		for (size_t i = 0; i < pools.size(); i++)
+		{
+			// Shades pixels darker every run, which doesn't change the work.
+			ms = timeBest([&]() { hillshade(map.data(), size, size, Hillshade(), pixels.data(), size, *pools[i]); }, suite.repeats);
+			record({ "hillshade", size, 0, 0, suite.threads[i], sizeof(float) + 4, ms });
+		}
+	}
+
+	if (!suite.json.empty() && !writeSuiteJson(suite.json, suite, results)) {
+		fprintf(stderr, "failed to write %s\n", suite.json.c_str());
+		return 1;
+	}
+	return 0;
+}
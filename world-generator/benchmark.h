@@ -0,0 +1,39 @@
+#pragma once
+
+#include "gradients.h"
+#include "thread_pool.h"
+
+#include <string>
+#include <vector>
+
+// Checks that every SIMD noise, colorize and colormap kernel this CPU can
+// run matches the scalar one. Returns a process exit code.
+int checkSimdKernels(size_t width = 1280, size_t height = 720);
+
+// Checks the kernels, then times generateMap on the pool against a thread
+// per call and prints the results. Returns a process exit code.
+int runBenchmark(ThreadPool& pool, size_t width = 1280, size_t height = 720);
+
+// Parameters of runBenchmarkSuite. Every combination of the lists is run.
+struct BenchmarkSuite {
+	// Edge lengths of the square maps.
+	std::vector<size_t> sizes = { 512, 2048 };
+	// Octave counts for generateMap.
+	std::vector<size_t> octaves = { 1, 8 };
+	// Perlin grid cell sizes for perlinNoise.
+	std::vector<size_t> cell_sizes = { 64 };
+	// Edge lengths of the square maps mapToPixels and hillshade convert.
+	std::vector<size_t> colorize_sizes = { 4096, 16384 };
+	// Pool sizes. mapToPixels is also timed without a pool.
+	std::vector<size_t> threads = { std::thread::hardware_concurrency() };
+	GradientSource gradients = GradientSource::Grid;
+	size_t repeats = 5;
+	// Also written as JSON to this file when not empty.
+	std::string json;
+};
+
+// Times generateMap, perlinNoise and mapToPixels for every parameter
+// combination and prints ns/pixel for each, and GB/s of map and pixel
+// traffic for the conversions.
+// Returns a process exit code.
+int runBenchmarkSuite(const BenchmarkSuite& suite);
@@ -0,0 +1,122 @@
+#include "benchmark.h"
+#include "parse_args.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// The whole range the suite is meant to cover. The defaults stay small so a
+// plain run finishes in seconds.
+const std::vector<size_t> FULL_SIZES = { 512, 1024, 2048, 4096, 8192, 16384 };
+const std::vector<size_t> FULL_OCTAVES = { 1, 2, 4, 8, 12 };
+
+void printUsage() {
+	printf(
+		"usage: worldgen-bench [options]\n"
+		"  --sizes N,...         square map edge lengths (default 512,2048)\n"
+		"  --octaves N,...       octave counts for generateMap (default 1,8)\n"
+		"  --cell-sizes N,...    cell sizes for perlinNoise and simplexNoise (default 64)\n"
+		"  --colorize-sizes N,...\n"
+		"                        square map edge lengths for mapToPixels and\n"
+		"                        hillshade (default 4096,16384)\n"
+		"  --threads N,...       pool sizes (default: all cores)\n"
+		"  --full                sweep sizes 512 to 16384 and 1 to 12 octaves instead\n"
+		"                        of the quick defaults; options after it override it\n"
+		"  --gradients grid|hash gradient source (default grid)\n"
+		"  --repeats N           runs per benchmark, the best is reported (default 5)\n"
+		"  --json PATH           also write the results as JSON\n"
+		"  --compare             check the SIMD kernels and compare the pool with\n"
+		"                        spawning threads per call instead\n"
+		"  --check               only check the SIMD kernels against the scalar ones\n");
+}
+
+// Comma-separated list of positive integers.
+bool parseSizeList(const char* text, std::vector<size_t>& values) {
+	values.clear();
+	std::string list = text;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t comma = std::min(list.find(',', start), list.size());
+		size_t value;
+		if (!parseSize(list.substr(start, comma - start).c_str(), value) || value == 0) return false;
+		values.push_back(value);
+		start = comma + 1;
+	}
+	return true;
+}
+
+bool parseOptions(int argc, char** argv, BenchmarkSuite& suite, bool& compare, bool& check, bool& help) {
+	for (int i = 1; i < argc; i++)
+	{
+		std::string name = argv[i];
+		if (name == "--help" || name == "-h") {
+			help = true;
+			return true;
+		}
+		if (name == "--compare") {
+			compare = true;
+			continue;
+		}
+		if (name == "--check") {
+			check = true;
+			continue;
+		}
+		if (name == "--full") {
+			suite.sizes = FULL_SIZES;
+			suite.octaves = FULL_OCTAVES;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			fprintf(stderr, "missing value for %s\n", name.c_str());
+			return false;
+		}
+		const char* value = argv[++i];
+		bool ok = true;
+		if (name == "--sizes") ok = parseSizeList(value, suite.sizes);
+		else if (name == "--octaves") ok = parseSizeList(value, suite.octaves);
+		else if (name == "--cell-sizes") ok = parseSizeList(value, suite.cell_sizes);
+		else if (name == "--colorize-sizes") ok = parseSizeList(value, suite.colorize_sizes);
+		else if (name == "--threads") ok = parseSizeList(value, suite.threads);
+		else if (name == "--repeats") ok = parseSize(value, suite.repeats) && suite.repeats > 0;
+		else if (name == "--json") suite.json = value;
+		else if (name == "--gradients") {
+			ok = strcmp(value, "grid") == 0 || strcmp(value, "hash") == 0;
+			suite.gradients = strcmp(value, "grid") == 0 ? GradientSource::Grid : GradientSource::Hash;
+		}
+		else {
+			fprintf(stderr, "unknown option %s\n", name.c_str());
+			return false;
+		}
+		if (!ok) {
+			fprintf(stderr, "invalid value for %s: %s\n", name.c_str(), value);
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+	BenchmarkSuite suite;
+	bool compare = false;
+	bool check = false;
+	bool help = false;
+	if (!parseOptions(argc, argv, suite, compare, check, help)) {
+		printUsage();
+		return 1;
+	}
+	if (help) {
+		printUsage();
+		return 0;
+	}
+	if (check) return checkSimdKernels();
+	if (compare) {
+		ThreadPool pool;
+		return runBenchmark(pool);
+	}
+	return runBenchmarkSuite(suite);
+}
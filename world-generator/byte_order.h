@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Every file format written here is little-endian, and so is every platform
+// we build for, so samples go to files and mappings straight from memory.
+// Anywhere else the build fails rather than writing byte-swapped files.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "worldgen writes host-order samples and needs a little-endian host"
+#endif
+
+// Stores the low size bytes of value at out, least significant first.
+inline void storeLittleEndian(uint8_t* out, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = (uint8_t)(value >> (i * 8));
+	}
+}
+
+// Copies count values to out in host byte order, which the check above
+// makes little-endian.
+template <typename T>
+void copyRaw(void* out, const T* values, size_t count) {
+	memcpy(out, values, count * sizeof(T));
+}
+
+// Writes count values to file in host byte order, little-endian as above.
+// Returns false if the write failed.
+template <typename T>
+bool writeRaw(FILE* file, const T* values, size_t count) {
+	return fwrite(values, sizeof(T), count, file) == count;
+}
@@ -0,0 +1,246 @@
+#include "worldgen.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+	size_t width = 1280;
+	size_t height = 720;
+	size_t octaves = 8;
+	float persistence = 0.5f;
+	float lacunarity = 2.0f;
+	uint32_t seed = 0;
+	size_t count = 1;
+	GradientSource gradients = GradientSource::Hash;
+	NoiseBackend noise = NoiseBackend::Perlin;
+	size_t threads = std::thread::hardware_concurrency();
+	std::string output;
+	bool mapped = false;
+	SampleType sample_type = SampleType::Float32;
+	TiffOptions tiff;
+	bool compact = false;
+	HeightEncoding encoding = HeightEncoding::Uint16;
+	bool help = false;
+};
+
+void printUsage() {
+	printf(
+		"usage: worldgen-cli [options]\n"
+		"  --width N             map width in pixels (default 1280)\n"
+		"  --height N            map height in pixels (default 720)\n"
+		"  --octaves N           number of octaves (default 8)\n"
+		"  --persistence F       amplitude factor per octave (default 0.5)\n"
+		"  --lacunarity F        frequency factor per octave (default 2)\n"
+		"  --seed N              seed of the first map (default 0)\n"
+		"  --count N             maps to generate with consecutive seeds (default 1)\n"
+		"  --gradients grid|hash gradient source (default hash)\n"
+		"  --noise perlin|simplex\n"
+		"                        noise every octave is made of (default perlin)\n"
+		"  --threads N           worker threads (default: all cores)\n"
+		"  --output PATH         .png (16-bit), .r16 (raw uint16), .r32 (raw float32),\n"
+		"                        .pgm (16-bit) or .tif (tiled float32 GeoTIFF with\n"
+		"                        overviews) file; with --count > 1 the seed is added\n"
+		"                        before the extension. Without it maps are generated\n"
+		"                        but not written. TIFFs are generated tile by tile\n"
+		"                        straight into the file.\n"
+		"  --tile-size N         TIFF tile size, a multiple of 16 (default 256)\n"
+		"  --compression deflate|none\n"
+		"                        TIFF tile compression (default deflate)\n"
+		"  --compact uint16|half\n"
+		"                        keep the map as 16-bit samples instead of floats,\n"
+		"                        uint16 quantized over the largest possible height\n"
+		"                        range or half floats; prints the error bound\n"
+		"  --mapped float32|uint16\n"
+		"                        generate straight into --output through a memory\n"
+		"                        mapping instead of RAM, for maps larger than memory.\n"
+		"                        The file is a 32-byte header and the samples.\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++)
+	{
+		std::string name = argv[i];
+		if (name == "--help" || name == "-h") {
+			options.help = true;
+			return true;
+		}
+		if (i + 1 >= argc) {
+			fprintf(stderr, "missing value for %s\n", name.c_str());
+			return false;
+		}
+		const char* value = argv[++i];
+		size_t seed;
+		bool ok = true;
+		if (name == "--width") ok = parseSize(value, options.width) && options.width > 0;
+		else if (name == "--height") ok = parseSize(value, options.height) && options.height > 0;
+		else if (name == "--octaves") ok = parseSize(value, options.octaves);
+		else if (name == "--persistence") ok = parseFloat(value, options.persistence) && std::isfinite(options.persistence);
+		else if (name == "--lacunarity") ok = parseFloat(value, options.lacunarity) && std::isfinite(options.lacunarity) && options.lacunarity > 0;
+		else if (name == "--seed") {
+			ok = parseSize(value, seed) && seed <= UINT32_MAX;
+			options.seed = (uint32_t)seed;
+		}
+		else if (name == "--count") ok = parseSize(value, options.count) && options.count > 0;
+		else if (name == "--threads") ok = parseSize(value, options.threads) && options.threads > 0;
+		else if (name == "--output") options.output = value;
+		else if (name == "--mapped") {
+			ok = strcmp(value, "float32") == 0 || strcmp(value, "uint16") == 0;
+			options.mapped = true;
+			options.sample_type = strcmp(value, "float32") == 0 ? SampleType::Float32 : SampleType::Uint16;
+		}
+		else if (name == "--tile-size") ok = parseSize(value, options.tiff.tile_size) && options.tiff.tile_size > 0 && options.tiff.tile_size % 16 == 0;
+		else if (name == "--compression") {
+			ok = strcmp(value, "deflate") == 0 || strcmp(value, "none") == 0;
+			options.tiff.deflate = strcmp(value, "deflate") == 0;
+		}
+		else if (name == "--compact") {
+			ok = strcmp(value, "uint16") == 0 || strcmp(value, "half") == 0;
+			options.compact = true;
+			options.encoding = strcmp(value, "uint16") == 0 ? HeightEncoding::Uint16 : HeightEncoding::Half;
+		}
+		else if (name == "--noise") {
+			ok = findNoiseBackend(value, options.noise);
+		}
+		else if (name == "--gradients") {
+			ok = strcmp(value, "grid") == 0 || strcmp(value, "hash") == 0;
+			options.gradients = strcmp(value, "grid") == 0 ? GradientSource::Grid : GradientSource::Hash;
+		}
+		else {
+			fprintf(stderr, "unknown option %s\n", name.c_str());
+			return false;
+		}
+		if (!ok) {
+			fprintf(stderr, "invalid value for %s: %s\n", name.c_str(), value);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Index of the dot starting the extension of path's file name, or
+// path.size() if it has none. Dots in directory names don't count.
+size_t extensionStart(const std::string& path) {
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path.size();
+	return dot;
+}
+
+bool isTiffPath(const std::string& path) {
+	std::string extension = path.substr(extensionStart(path));
+	return extension == ".tif" || extension == ".tiff";
+}
+
+std::string outputPath(const std::string& output, size_t count, uint32_t seed) {
+	if (count == 1) return output;
+	size_t dot = extensionStart(output);
+	return output.substr(0, dot) + "_" + std::to_string(seed) + output.substr(dot);
+}
+
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+	if (options.help) {
+		printUsage();
+		return 0;
+	}
+	HeightmapFormat format = HeightmapFormat::RawFloat32;
+	if (options.mapped && options.output.empty()) {
+		fprintf(stderr, "--mapped needs --output\n");
+		return 1;
+	}
+	bool tiff = !options.mapped && isTiffPath(options.output);
+	if (options.compact && (options.mapped || tiff)) {
+		fprintf(stderr, "--compact can't be combined with --mapped or .tif output\n");
+		return 1;
+	}
+	if (!options.mapped && !tiff && !options.output.empty() && !heightmapFormatFromPath(options.output, format)) {
+		fprintf(stderr, "unknown output format: %s (expected .png, .r16, .r32, .pgm or .tif)\n", options.output.c_str());
+		return 1;
+	}
+
+	ThreadPool pool(options.threads);
+	// Neither a mapped map nor a TIFF ever lives in RAM, and a compact one
+	// only as 16-bit samples.
+	std::vector<float> map(options.mapped || tiff || options.compact ? 0 : options.width * options.height);
+	CompactHeightfield compact;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < options.count; i++)
+	{
+		uint32_t seed = options.seed + (uint32_t)i;
+		if (options.mapped) {
+			std::string path = outputPath(options.output, options.count, seed);
+			MappedHeightmap mapped;
+			if (!mapped.create(path, options.width, options.height, options.sample_type)) {
+				fprintf(stderr, "failed to create %s\n", path.c_str());
+				return 1;
+			}
+			if (!generateMapToFile(mapped, options.octaves, options.persistence, options.lacunarity, seed, options.gradients, options.noise, pool) || !mapped.close()) {
+				fprintf(stderr, "failed to write %s\n", path.c_str());
+				return 1;
+			}
+			continue;
+		}
+		if (tiff) {
+			std::string path = outputPath(options.output, options.count, seed);
+			if (!generateTiledTiff(path, options.width, options.height, options.octaves, options.persistence, options.lacunarity, seed, options.gradients, options.noise, options.tiff, pool)) {
+				fprintf(stderr, "failed to write %s\n", path.c_str());
+				return 1;
+			}
+			continue;
+		}
+		if (options.compact) {
+			float bound = heightBound(octaveSpecs(options.width, options.octaves, options.persistence, options.lacunarity, seed), options.noise);
+			compact = CompactHeightfield(options.width, options.height, options.encoding, -bound, bound);
+			if (!generateCompactMap(compact, options.octaves, options.persistence, options.lacunarity, seed, options.gradients, options.noise, pool)) {
+				fprintf(stderr, "failed to generate\n");
+				return 1;
+			}
+			if (options.output.empty()) continue;
+
+			std::string path = outputPath(options.output, options.count, seed);
+			if (!writeHeightmap(path, compact, format)) {
+				fprintf(stderr, "failed to write %s\n", path.c_str());
+				return 1;
+			}
+			continue;
+		}
+		if (!generateMap(map.data(), options.width, options.height, options.octaves, options.persistence, options.lacunarity, seed, options.gradients, options.noise, pool)) {
+			fprintf(stderr, "failed to generate\n");
+			return 1;
+		}
+		if (options.output.empty()) continue;
+
+		std::string path = outputPath(options.output, options.count, seed);
+		if (!writeHeightmap(path, map.data(), options.width, options.height, format)) {
+			fprintf(stderr, "failed to write %s\n", path.c_str());
+			return 1;
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (options.compact) {
+		printf("compact %s samples in [%g, %g], error bound %g\n", options.encoding == HeightEncoding::Uint16 ? "uint16" : "half",
+			compact.min(), compact.max(), compact.errorBound());
+	}
+
+	double seconds = elapsed.count();
+	double pixels = (double)options.width * options.height * options.count;
+	printf("%zu map(s) of %zux%zu, %zu octaves of %s noise, %zu threads: %.3f s, %.3f ms/map, %.0f maps/hour, %.1f Mpixel/s\n",
+		options.count, options.width, options.height, options.octaves, noiseBackend(options.noise).name, pool.size(),
+		seconds, seconds * 1000 / options.count, options.count * 3600 / seconds, pixels / seconds / 1e6);
+	return 0;
+}
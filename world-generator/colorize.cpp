@@ -0,0 +1,174 @@
+#include "colorize.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Rows mapToPixels hands to a worker at a time.
+const size_t ROWS_PER_TASK = 16;
+
+void colorize_scalar(const float* map, size_t n, uint8_t* pixels) {
+	for (size_t k = 0; k < n; k++)
+	{
+		float color = std::min(255.f, std::max(0.f, (map[k] + 1.f) * 0.5f * 255.f));
+		uint8_t gray = (uint8_t)color;
+		pixels[k * 4]	  = gray;
+		pixels[k * 4 + 1] = gray;
+		pixels[k * 4 + 2] = gray;
+		pixels[k * 4 + 3] = 255;
+	}
+}
+
+void colormap_scalar(const float* map, size_t n, const uint32_t* lut, uint8_t* pixels) {
+	for (size_t k = 0; k < n; k++)
+	{
+		memcpy(pixels + k * 4, lut + Colormap::lutIndex(map[k]), 4);
+	}
+}
+
+#ifdef WG_X86
+
+// Each gray value is truncated to a 32-bit lane and spread over its R, G
+// and B bytes, so a whole RGBA pixel is written per lane.
+void colorize_sse(const float* map, size_t n, uint8_t* pixels) {
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 white = _mm_set1_ps(255.f);
+	const __m128 black = _mm_setzero_ps();
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+
+	size_t k = 0;
+	for (; k + 4 <= n; k += 4)
+	{
+		__m128 color = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(map + k), one), half), white);
+		__m128i gray = _mm_cvttps_epi32(_mm_min_ps(white, _mm_max_ps(color, black)));
+		__m128i rgba = _mm_or_si128(_mm_or_si128(gray, _mm_slli_epi32(gray, 8)), _mm_or_si128(_mm_slli_epi32(gray, 16), alpha));
+		_mm_storeu_si128((__m128i*)(pixels + k * 4), rgba);
+	}
+	colorize_scalar(map + k, n - k, pixels + k * 4);
+}
+
+WG_TARGET_AVX2
+void colorize_avx2(const float* map, size_t n, uint8_t* pixels) {
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 white = _mm256_set1_ps(255.f);
+	const __m256 black = _mm256_setzero_ps();
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8)
+	{
+		__m256 color = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(map + k), one), half), white);
+		__m256i gray = _mm256_cvttps_epi32(_mm256_min_ps(white, _mm256_max_ps(color, black)));
+		__m256i rgba = _mm256_or_si256(_mm256_or_si256(gray, _mm256_slli_epi32(gray, 8)), _mm256_or_si256(_mm256_slli_epi32(gray, 16), alpha));
+		_mm256_storeu_si256((__m256i*)(pixels + k * 4), rgba);
+	}
+	colorize_sse(map + k, n - k, pixels + k * 4);
+}
+
+// Table indices are computed four at a time, the lookups stay scalar.
+void colormap_sse(const float* map, size_t n, const uint32_t* lut, uint8_t* pixels) {
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 last = _mm_set1_ps((float)(Colormap::LUT_SIZE - 1));
+	const __m128 zero = _mm_setzero_ps();
+
+	size_t k = 0;
+	for (; k + 4 <= n; k += 4)
+	{
+		__m128 position = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(map + k), one), half), last), half);
+		alignas(16) int32_t index[4];
+		_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(_mm_min_ps(last, _mm_max_ps(position, zero))));
+		__m128i rgba = _mm_setr_epi32((int)lut[index[0]], (int)lut[index[1]], (int)lut[index[2]], (int)lut[index[3]]);
+		_mm_storeu_si128((__m128i*)(pixels + k * 4), rgba);
+	}
+	colormap_scalar(map + k, n - k, lut, pixels + k * 4);
+}
+
+WG_TARGET_AVX2
+void colormap_avx2(const float* map, size_t n, const uint32_t* lut, uint8_t* pixels) {
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 last = _mm256_set1_ps((float)(Colormap::LUT_SIZE - 1));
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8)
+	{
+		__m256 position = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(map + k), one), half), last), half);
+		__m256i index = _mm256_cvttps_epi32(_mm256_min_ps(last, _mm256_max_ps(position, zero)));
+		_mm256_storeu_si256((__m256i*)(pixels + k * 4), _mm256_i32gather_epi32((const int*)lut, index, 4));
+	}
+	colormap_sse(map + k, n - k, lut, pixels + k * 4);
+}
+
+#endif
+
+void colorizeRows(const float* map, size_t map_stride, size_t width, size_t height, uint8_t* pixels, size_t p_width, const Colormap* colormap)
+{
+	ColorizeKernel kernel = colorizeKernel(detectSimdLevel());
+	ColormapKernel lut_kernel = colormapKernel(detectSimdLevel());
+	for (size_t i = 0; i < height; i++)
+	{
+		if (colormap) lut_kernel(map + i * map_stride, width, colormap->lut(), pixels + i * p_width * 4);
+		else kernel(map + i * map_stride, width, pixels + i * p_width * 4);
+	}
+}
+
+}
+
+ColorizeKernel colorizeKernel(SimdLevel level) {
+#ifdef WG_X86
+	if (level == SimdLevel::AVX2) return colorize_avx2;
+	if (level == SimdLevel::SSE) return colorize_sse;
+#endif
+	return colorize_scalar;
+}
+
+ColormapKernel colormapKernel(SimdLevel level) {
+#ifdef WG_X86
+	if (level == SimdLevel::AVX2) return colormap_avx2;
+	if (level == SimdLevel::SSE) return colormap_sse;
+#endif
+	return colormap_scalar;
+}
+
+void mapToPixels(const float* map, size_t width, size_t height, uint8_t* pixels, size_t p_width, const Colormap* colormap)
+{
+	colorizeRows(map, width, width, height, pixels, p_width, colormap);
+}
+
+void mapToPixels(const float* map, size_t width, size_t height, uint8_t* pixels, size_t p_width, ThreadPool& pool, const Colormap* colormap)
+{
+	size_t tasks = 1 + (height - 1) / ROWS_PER_TASK;
+	pool.parallelFor(tasks, [&](size_t i) {
+		size_t y0 = i * ROWS_PER_TASK;
+		colorizeRows(map + y0 * width, width, width, std::min(ROWS_PER_TASK, height - y0), pixels + y0 * p_width * 4, p_width, colormap);
+		});
+}
+
+void mapRectToPixels(const float* map, size_t width, const DirtyRect& rect, uint8_t* pixels, size_t p_width, const Colormap* colormap)
+{
+	colorizeRows(map + rect.y * width + rect.x, width, rect.width, rect.height, pixels + (rect.y * p_width + rect.x) * 4, p_width, colormap);
+}
+
+void mapToPixels(const CompactHeightfield& map, uint8_t* pixels, size_t p_width, ThreadPool& pool, const Colormap* colormap)
+{
+	size_t width = map.width();
+	size_t height = map.height();
+	size_t tasks = 1 + (height - 1) / ROWS_PER_TASK;
+	pool.parallelFor(tasks, [&](size_t i) {
+		size_t y0 = i * ROWS_PER_TASK;
+		size_t rows = std::min(ROWS_PER_TASK, height - y0);
+		std::vector<float> row(width);
+		for (size_t y = y0; y < y0 + rows; y++)
+		{
+			map.decode(y * width, width, row.data());
+			colorizeRows(row.data(), width, width, 1, pixels + y * p_width * 4, p_width, colormap);
+		}
+		});
+}
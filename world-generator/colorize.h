@@ -0,0 +1,38 @@
+#pragma once
+
+#include "colormap.h"
+#include "compact_heightfield.h"
+#include "dirty_rect.h"
+#include "perlin_kernel.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Converts n heights in [-1, 1] to opaque grayscale RGBA pixels. Heights
+// outside the range saturate to black or white.
+typedef void (*ColorizeKernel)(const float* map, size_t n, uint8_t* pixels);
+
+// Every level gives the same pixels.
+ColorizeKernel colorizeKernel(SimdLevel level);
+
+// Converts n heights to pixels by looking up Colormap::lutIndex of each in
+// lut, a Colormap::lut().
+typedef void (*ColormapKernel)(const float* map, size_t n, const uint32_t* lut, uint8_t* pixels);
+
+// Every level gives the same pixels.
+ColormapKernel colormapKernel(SimdLevel level);
+
+// Writes the map into an RGBA buffer whose rows are p_width pixels long,
+// through colormap if given and as opaque grayscale otherwise.
+void mapToPixels(const float* map, size_t width, size_t height, uint8_t* pixels, size_t p_width, const Colormap* colormap = nullptr);
+
+// Same as mapToPixels with bands of rows spread over the pool.
+void mapToPixels(const float* map, size_t width, size_t height, uint8_t* pixels, size_t p_width, ThreadPool& pool, const Colormap* colormap = nullptr);
+
+// Same as mapToPixels for rect of a width wide map only.
+void mapRectToPixels(const float* map, size_t width, const DirtyRect& rect, uint8_t* pixels, size_t p_width, const Colormap* colormap = nullptr);
+
+// Same as the pooled mapToPixels for a compact map, decoded a row at a time
+// so the float map never exists.
+void mapToPixels(const CompactHeightfield& map, uint8_t* pixels, size_t p_width, ThreadPool& pool, const Colormap* colormap = nullptr);
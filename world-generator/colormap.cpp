@@ -0,0 +1,60 @@
+#include "colormap.h"
+
+#include <algorithm>
+
+namespace {
+
+uint32_t packColor(const float* color) {
+	uint32_t rgba = 0xFF000000u;
+	for (size_t c = 0; c < 3; c++)
+	{
+		float channel = std::min(1.f, std::max(0.f, color[c]));
+		rgba |= (uint32_t)(channel * 255.f + 0.5f) << (8 * c);
+	}
+	return rgba;
+}
+
+}
+
+Colormap::Colormap(std::vector<ColorStop> stops) : m_stops(std::move(stops)), m_lut(LUT_SIZE, 0xFF000000u) {
+	std::stable_sort(m_stops.begin(), m_stops.end(), [](const ColorStop& a, const ColorStop& b) { return a.height < b.height; });
+	if (m_stops.empty()) return;
+
+	size_t next = 0;
+	for (size_t i = 0; i < LUT_SIZE; i++)
+	{
+		float height = -1.f + 2.f * i / (LUT_SIZE - 1);
+		while (next < m_stops.size() && m_stops[next].height <= height) next++;
+		if (next == 0 || next == m_stops.size()) {
+			m_lut[i] = packColor(m_stops[next == 0 ? 0 : next - 1].color);
+			continue;
+		}
+		const ColorStop& below = m_stops[next - 1];
+		const ColorStop& above = m_stops[next];
+		float t = (height - below.height) / (above.height - below.height);
+		float color[3];
+		for (size_t c = 0; c < 3; c++)
+		{
+			color[c] = below.color[c] + t * (above.color[c] - below.color[c]);
+		}
+		m_lut[i] = packColor(color);
+	}
+}
+
+size_t Colormap::lutIndex(float height) {
+	// Same operations as the colorize kernels so every path picks the same
+	// entry.
+	const float last = (float)(LUT_SIZE - 1);
+	return (size_t)std::min(last, std::max(0.f, (height + 1.f) * 0.5f * last + 0.5f));
+}
+
+std::vector<ColorStop> biomeStops() {
+	return {
+		{ "Deep water", -0.45f, { 0.04f, 0.10f, 0.33f } },
+		{ "Shallows", -0.04f, { 0.20f, 0.47f, 0.70f } },
+		{ "Sand", 0.f, { 0.86f, 0.80f, 0.58f } },
+		{ "Grass", 0.06f, { 0.30f, 0.56f, 0.22f } },
+		{ "Rock", 0.25f, { 0.47f, 0.43f, 0.39f } },
+		{ "Snow", 0.38f, { 0.96f, 0.96f, 0.98f } },
+	};
+}
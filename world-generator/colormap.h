@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Color of a Colormap at a height in [-1, 1]. color is RGB in [0, 1], the
+// way ImGui edits it.
+struct ColorStop {
+	std::string name;
+	float height;
+	float color[3];
+};
+
+// Maps heights to RGBA through a table of LUT_SIZE precomputed pixels, so
+// colorizing costs one lookup per pixel whatever the stops are. Colors are
+// blended linearly between stops. Heights below the first stop or above
+// the last one get its color.
+class Colormap {
+public:
+	static const size_t LUT_SIZE = 4096;
+
+	explicit Colormap(std::vector<ColorStop> stops);
+
+	// Sorted by height.
+	const std::vector<ColorStop>& stops() const { return m_stops; }
+
+	// LUT_SIZE pixels packed as little-endian RGBA. Entry i is the color of
+	// height -1 + 2 * i / (LUT_SIZE - 1).
+	const uint32_t* lut() const { return m_lut.data(); }
+
+	// Entry of lut() nearest to height, clamped to the table. NaN gives
+	// entry 0.
+	static size_t lutIndex(float height);
+
+private:
+	std::vector<ColorStop> m_stops;
+	std::vector<uint32_t> m_lut;
+};
+
+// Elevation bands from deep water through shallows, sand, grass and rock to
+// snow, for fBm maps whose heights mostly stay within [-0.5, 0.5].
+std::vector<ColorStop> biomeStops();
@@ -0,0 +1,174 @@
+#include "compact_heightfield.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	// 2^16 and above overflow to infinity. NaN stays NaN, quiet, with the
+	// top of its payload, as F16C converts it.
+	if (magnitude > 0x7F800000) return sign | 0x7E00 | (uint16_t)((magnitude >> 13) & 0x3FF);
+	if (magnitude >= 0x47800000) return sign | 0x7C00;
+
+	uint32_t h;
+	uint32_t rest;
+	uint32_t tie;
+	if (magnitude < 0x38800000) {
+		// Below 2^-14 halves are subnormal, multiples of 2^-24.
+		uint32_t shift = 126 - (magnitude >> 23);
+		if (shift > 24) return sign;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		h = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		tie = 1u << (shift - 1);
+	}
+	else {
+		// Rebias the exponent from 127 to 15 and drop 13 mantissa bits. A
+		// carry out of the mantissa correctly bumps the exponent.
+		h = (magnitude - 0x38000000) >> 13;
+		rest = magnitude & 0x1FFF;
+		tie = 0x1000;
+	}
+	if (rest > tie || (rest == tie && (h & 1))) h++;
+	return sign | (uint16_t)h;
+}
+
+float halfToFloat(uint16_t h) {
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	if (exponent == 0) {
+		float value = mantissa * (1.f / 16777216.f);
+		return h & 0x8000 ? -value : value;
+	}
+	uint32_t bits = (uint32_t)(h & 0x8000) << 16;
+	// NaNs come out quiet, as F16C converts them.
+	bits |= exponent == 31 ? 0x7F800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0) : ((exponent + 112) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+#ifdef WG_X86
+
+WG_TARGET_AVX2 void encodeHalfAvx2(const float* in, size_t n, uint16_t* out) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		_mm_storeu_si128((__m128i*)(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = floatToHalf(in[i]);
+	}
+}
+
+WG_TARGET_AVX2 void decodeHalfAvx2(const uint16_t* in, size_t n, float* out) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		_mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + i))));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = halfToFloat(in[i]);
+	}
+}
+
+#endif
+
+}
+
+float heightBound(const std::vector<OctaveSpec>& specs, NoiseBackend noise) {
+	float amplitude = 0.f;
+	for (const OctaveSpec& spec : specs) {
+		amplitude += std::fabs(spec.amplitude);
+	}
+	return amplitude * noiseBackend(noise).bound;
+}
+
+CompactHeightfield::CompactHeightfield(size_t width, size_t height, HeightEncoding encoding, float min, float max)
+	: m_width(width), m_height(height), m_encoding(encoding), m_min(min), m_max(max > min ? max : min + 1.f), m_samples(width * height) {}
+
+void CompactHeightfield::encode(const float* in, size_t offset, size_t n) {
+	uint16_t* out = m_samples.data() + offset;
+	if (m_encoding == HeightEncoding::Half) {
+#ifdef WG_X86
+		// F16C rounds the same way as floatToHalf.
+		if (detectSimdLevel() == SimdLevel::AVX2) return encodeHalfAvx2(in, n, out);
+#endif
+		for (size_t i = 0; i < n; i++)
+		{
+			out[i] = floatToHalf(in[i]);
+		}
+		return;
+	}
+	float scale = 65535.f / (m_max - m_min);
+	for (size_t i = 0; i < n; i++)
+	{
+		float step = std::min(65535.f, std::max(0.f, (in[i] - m_min) * scale));
+		out[i] = (uint16_t)(step + 0.5f);
+	}
+}
+
+void CompactHeightfield::decode(size_t offset, size_t n, float* out) const {
+	const uint16_t* in = m_samples.data() + offset;
+	if (m_encoding == HeightEncoding::Half) {
+#ifdef WG_X86
+		if (detectSimdLevel() == SimdLevel::AVX2) return decodeHalfAvx2(in, n, out);
+#endif
+		for (size_t i = 0; i < n; i++)
+		{
+			out[i] = halfToFloat(in[i]);
+		}
+		return;
+	}
+	float step = (m_max - m_min) / 65535.f;
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = m_min + in[i] * step;
+	}
+}
+
+float CompactHeightfield::errorBound() const {
+	float largest = std::max(std::fabs(m_min), std::fabs(m_max));
+	if (m_encoding == HeightEncoding::Uint16) {
+		// Scaling, the step and the sum each round once, a few ulps at most.
+		return (m_max - m_min) / 131070.f + 2 * (m_max - m_min + largest) * FLT_EPSILON;
+	}
+	// Halves in [2^e, 2^(e + 1)) are 2^(e - 10) apart; subnormals 2^-24.
+	int exponent;
+	std::frexp(largest, &exponent);
+	return std::ldexp(1.f, std::max(exponent - 12, -25));
+}
+
+bool generateCompactMap(CompactHeightfield& out, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	size_t width = out.width();
+	size_t height = out.height();
+	std::vector<Octave> layers;
+	if (!mapOctaves(layers, width, height, octaves, persistence, lacunarity, seed, source, noise, cancel)) return false;
+	if (progress) {
+		progress->done = 0;
+		progress->total = sampleTiles(width, height, 1);
+	}
+
+	// A band of tile rows is generated as floats, then encoded a row per
+	// task, so the float map never exists in full.
+	std::vector<float> band(width * TILE_SIZE);
+	for (size_t y = 0; y < height; y += TILE_SIZE)
+	{
+		size_t rows = std::min(TILE_SIZE, height - y);
+		if (!generateRows(band.data(), width, y, rows, layers, pool, progress, cancel)) return false;
+		pool.parallelFor(rows, [&](size_t row) {
+			out.encode(band.data() + row * width, (y + row) * width, width);
+			});
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "generator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class HeightEncoding {
+	// Heights in [min, max] mapped linearly to [0, 65535], rounded to the
+	// nearest step and clamped.
+	Uint16,
+	// IEEE 754 half floats, rounded to nearest even.
+	Half,
+};
+
+// Bound on |height| in a map summed from these octaves of noise, e.g. as
+// the range of a Uint16 CompactHeightfield that no height can fall outside
+// of.
+float heightBound(const std::vector<OctaveSpec>& specs, NoiseBackend noise);
+
+// A map stored as 16-bit samples rather than floats, for half the memory
+// and bandwidth. Reading a sample back differs from the height stored by at
+// most errorBound().
+class CompactHeightfield {
+public:
+	CompactHeightfield() = default;
+	// min and max are the range of heights expected. Uint16 clamps to it;
+	// for Half it only sets errorBound(). A range without width, max <= min,
+	// becomes [min, min + 1], so e.g. an all-zero map still encodes exactly.
+	CompactHeightfield(size_t width, size_t height, HeightEncoding encoding, float min = -1.f, float max = 1.f);
+
+	size_t width() const { return m_width; }
+	size_t height() const { return m_height; }
+	HeightEncoding encoding() const { return m_encoding; }
+	float min() const { return m_min; }
+	float max() const { return m_max; }
+
+	uint16_t* data() { return m_samples.data(); }
+	const uint16_t* data() const { return m_samples.data(); }
+
+	// Stores n heights from in as the samples starting at index offset.
+	void encode(const float* in, size_t offset, size_t n);
+
+	// Reads n samples starting at index offset back into out.
+	void decode(size_t offset, size_t n, float* out) const;
+
+	// Largest difference between a height in [min, max] and its decoded
+	// sample. For Uint16 that is half a step, (max - min) / 131070, plus
+	// float rounding. For Half it is half the spacing of half floats around
+	// the larger of |min| and |max|, 2^-11 of it at most, so it grows with
+	// the range but not with its offset from zero.
+	float errorBound() const;
+
+private:
+	size_t m_width = 0;
+	size_t m_height = 0;
+	HeightEncoding m_encoding = HeightEncoding::Uint16;
+	float m_min = -1.f;
+	float m_max = 1.f;
+	std::vector<uint16_t> m_samples;
+};
+
+// Generates the map generateMap would produce straight into out's
+// encoding, a band of generateRows at a time, so the float map never exists.
+// progress and the return value are as for generateMap.
+bool generateCompactMap(CompactHeightfield& out, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
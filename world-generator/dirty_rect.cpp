@@ -0,0 +1,43 @@
+#include "dirty_rect.h"
+
+#include <algorithm>
+
+namespace {
+
+bool blockDiffers(const float* before, const float* after, size_t width, size_t x0, size_t y0, size_t w, size_t h) {
+	for (size_t y = y0; y < y0 + h; y++)
+	{
+		if (memcmp(before + y * width + x0, after + y * width + x0, w * sizeof(float)) != 0) return true;
+	}
+	return false;
+}
+
+}
+
+std::vector<DirtyRect> diffMaps(const float* before, const float* after, size_t width, size_t height, size_t tile) {
+	std::vector<DirtyRect> rects;
+	for (size_t y0 = 0; y0 < height; y0 += tile)
+	{
+		size_t h = std::min(tile, height - y0);
+		bool open = false;
+		for (size_t x0 = 0; x0 < width; x0 += tile)
+		{
+			size_t w = std::min(tile, width - x0);
+			if (!blockDiffers(before, after, width, x0, y0, w, h)) {
+				open = false;
+				continue;
+			}
+			if (open) rects.back().width += w;
+			else rects.push_back({ x0, y0, w, h });
+			open = true;
+		}
+	}
+	return rects;
+}
+
+void extractRect(const uint8_t* pixels, size_t p_width, const DirtyRect& rect, uint8_t* out) {
+	for (size_t y = 0; y < rect.height; y++)
+	{
+		memcpy(out + y * rect.width * 4, pixels + ((rect.y + y) * p_width + rect.x) * 4, rect.width * 4);
+	}
+}
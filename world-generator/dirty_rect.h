@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Pixel rectangle of a map or image that changed.
+struct DirtyRect {
+	size_t x;
+	size_t y;
+	size_t width;
+	size_t height;
+};
+
+// Compares two width x height maps in tile x tile blocks and returns the
+// blocks that differ. Neighbouring dirty blocks in a row of blocks are
+// merged into one rect.
+std::vector<DirtyRect> diffMaps(const float* before, const float* after, size_t width, size_t height, size_t tile);
+
+// Copies rect between two images whose rows are stride pixels of channels
+// values each.
+template <typename T>
+void copyRect(const T* src, T* dst, size_t stride, const DirtyRect& rect, size_t channels = 1) {
+	for (size_t y = rect.y; y < rect.y + rect.height; y++)
+	{
+		size_t offset = (y * stride + rect.x) * channels;
+		memcpy(dst + offset, src + offset, rect.width * channels * sizeof(T));
+	}
+}
+
+// Copies rect of an RGBA image with p_width pixel rows into out, packed,
+// e.g. for a sub-rectangle texture update.
+void extractRect(const uint8_t* pixels, size_t p_width, const DirtyRect& rect, uint8_t* out);
@@ -0,0 +1,236 @@
+#include "generator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+size_t noLatticePadding(size_t, size_t) {
+	return 0;
+}
+
+void perlinRect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, SimdLevel level, size_t step) {
+	perlin_process_rect(out, out_stride, gradients, size, x0, y0, width, height, perlinSpanKernel(level), step);
+}
+
+void simplexRect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, SimdLevel level, size_t step) {
+	simplex_process_rect(out, out_stride, gradients, size, x0, y0, width, height, simplexSpanKernel(level), step);
+}
+
+// In the order of NoiseBackend.
+const NoiseBackendOps NOISE_BACKENDS[] = {
+	{ "perlin", PERLIN_BOUND, noLatticePadding, perlinRect },
+	{ "simplex", SIMPLEX_BOUND, simplexLatticeSkew, simplexRect },
+};
+static_assert(sizeof(NOISE_BACKENDS) / sizeof(NOISE_BACKENDS[0]) == NOISE_BACKEND_COUNT, "every backend needs an entry");
+
+// Gradients for one layer of a width x height map with the given cell size.
+GradientField layerGradients(GradientSource source, NoiseBackend noise, uint32_t seed, size_t width, size_t height, size_t grid_cell_size) {
+	size_t grid_w = 1 + (width - 1) / grid_cell_size + 1;
+	size_t grid_h = 1 + (height - 1) / grid_cell_size + 1;
+	size_t padding = noiseBackend(noise).lattice_padding(grid_w, grid_h);
+	return GradientField(source, seed, grid_w + padding, grid_h + padding);
+}
+
+// Lattice cell of coordinate v, rounding down for negative v too.
+int64_t cellOf(int64_t v, size_t size) {
+	int64_t s = (int64_t)size;
+	return v >= 0 ? v / s : -((-v + s - 1) / s);
+}
+
+// Sums layers at n pixels of row y, starting at x and step pixels apart,
+// into sum. value is scratch space of TILE_SIZE floats.
+void sumOctaves(float* sum, float* value, const std::vector<Octave>& layers, size_t x, size_t y, size_t n, size_t step, SimdLevel level) {
+	std::fill(sum, sum + n, 0.f);
+	for (const Octave& octave : layers) {
+		octave_process_rect(value, TILE_SIZE, octave, x, y, n, 1, level, step);
+		for (size_t j = 0; j < n; j++)
+		{
+			sum[j] += value[j] * octave.amplitude;
+		}
+	}
+}
+
+}
+
+void perlin_process_rect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, PerlinSpanKernel kernel, size_t step) {
+	for (size_t j = 0; j < height; j++)
+	{
+		int64_t y = y0 + (int64_t)(j * step);
+		int64_t absolute_y = cellOf(y, size);
+		float fy = (float)(y - absolute_y * (int64_t)size) / size;
+		float sy = perlin_smoothstep(fy);
+		float* row = out + j * out_stride;
+
+		// Corner gradients are hoisted per cell and the kernel runs over
+		// the whole part of the row that falls into that cell.
+		for (size_t i = 0; i < width;)
+		{
+			int64_t x = x0 + (int64_t)(i * step);
+			int64_t absolute_x = cellOf(x, size);
+			size_t lx = (size_t)(x - absolute_x * (int64_t)size);
+			size_t n = std::min((size - lx + step - 1) / step, width - i);
+
+			float g[8];
+			gradients.cellCorners(absolute_x, absolute_y, g);
+			kernel(row + i, n, lx, step, (float)size, fy, sy, g);
+			i += n;
+		}
+	}
+}
+
+void octave_process_rect(float* out, size_t out_stride, const Octave& octave, int64_t x0, int64_t y0, size_t width, size_t height, SimdLevel level, size_t step) {
+	octave.backend->process_rect(out, out_stride, octave.gradients, octave.grid_cell_size, x0, y0, width, height, level, step);
+}
+
+const NoiseBackendOps& noiseBackend(NoiseBackend noise) {
+	return NOISE_BACKENDS[(size_t)noise];
+}
+
+bool findNoiseBackend(const char* name, NoiseBackend& noise) {
+	for (size_t i = 0; i < NOISE_BACKEND_COUNT; i++)
+	{
+		if (strcmp(NOISE_BACKENDS[i].name, name) == 0) {
+			noise = (NoiseBackend)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool noiseLayer(float* map, size_t width, size_t height, size_t grid_cell_size, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	Octave octave{ layerGradients(source, noise, seed, width, height, grid_cell_size), grid_cell_size, 1.f, &noiseBackend(noise) };
+
+	// Work is split into fixed-size tiles rather than Perlin cells, so low
+	// octaves with only a handful of cells still spread over every worker.
+	SimdLevel level = detectSimdLevel();
+	size_t tiles_w = 1 + (width - 1) / TILE_SIZE;
+	size_t tiles_h = 1 + (height - 1) / TILE_SIZE;
+	pool.parallelFor(tiles_w * tiles_h, [&](size_t i) {
+		if (cancel && cancel->cancelled()) return;
+		size_t x0 = (i % tiles_w) * TILE_SIZE;
+		size_t y0 = (i / tiles_w) * TILE_SIZE;
+		octave_process_rect(map + y0 * width + x0, width, octave, x0, y0, std::min(TILE_SIZE, width - x0), std::min(TILE_SIZE, height - y0), level);
+		if (progress) progress->done++;
+		});
+	return !(cancel && cancel->cancelled());
+}
+
+bool perlinNoise(float* map, size_t width, size_t height, size_t grid_cell_size, uint32_t seed, GradientSource source, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	return noiseLayer(map, width, height, grid_cell_size, seed, source, NoiseBackend::Perlin, pool, progress, cancel);
+}
+
+size_t sampleTiles(size_t width, size_t height, size_t step) {
+	size_t tiles_w = 1 + (sampleCount(width, step) - 1) / TILE_SIZE;
+	size_t tiles_h = 1 + (sampleCount(height, step) - 1) / TILE_SIZE;
+	return tiles_w * tiles_h;
+}
+
+std::vector<OctaveSpec> octaveSpecs(size_t width, size_t octaves, float persistence, float lacunarity, uint32_t seed) {
+	float frequency = 2;
+	float amplitude = 0.5;
+	std::vector<OctaveSpec> specs;
+	specs.reserve(octaves);
+	for (size_t i = 0; i < octaves; i++) {
+		frequency *= lacunarity;
+		amplitude *= persistence;
+		// Cells are kept between one pixel and the map's width, so lacunarities
+		// that drive the frequency to 0, inf or nan still give a valid size.
+		float cell_size = std::min<float>((float)width, std::max(1.f, width / frequency));
+		specs.push_back({ octaveSeed(seed, i), (size_t)cell_size, amplitude });
+	}
+	return specs;
+}
+
+bool mapOctaves(std::vector<Octave>& layers, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, const CancellationToken* cancel) {
+	layers.clear();
+	layers.reserve(octaves);
+	for (const OctaveSpec& spec : octaveSpecs(width, octaves, persistence, lacunarity, seed)) {
+		if (cancel && cancel->cancelled()) return false;
+		layers.push_back({ layerGradients(source, noise, spec.seed, width, height, spec.grid_cell_size), spec.grid_cell_size, spec.amplitude, &noiseBackend(noise) });
+	}
+	return true;
+}
+
+bool sampleOctaves(float* out, size_t width, size_t height, size_t step, const std::vector<Octave>& layers, ThreadPool& pool, const float* coarse, GenerationProgress* progress, const CancellationToken* cancel) {
+	size_t out_w = sampleCount(width, step);
+	size_t out_h = sampleCount(height, step);
+	size_t coarse_w = sampleCount(width, step * 2);
+
+	// Fused fBm: every tile row sums all octaves in a stack buffer and is
+	// written to the map once, so there is no full-size temporary layer.
+	SimdLevel level = detectSimdLevel();
+	size_t tiles_w = 1 + (out_w - 1) / TILE_SIZE;
+	size_t tiles_h = 1 + (out_h - 1) / TILE_SIZE;
+	pool.parallelFor(tiles_w * tiles_h, [&](size_t i) {
+		// Tiles left after a cancel are skipped, so parallelFor returns as
+		// soon as the tiles already started are done.
+		if (cancel && cancel->cancelled()) return;
+		size_t x0 = (i % tiles_w) * TILE_SIZE;
+		size_t y0 = (i / tiles_w) * TILE_SIZE;
+		size_t tile_w = std::min(TILE_SIZE, out_w - x0);
+		size_t tile_h = std::min(TILE_SIZE, out_h - y0);
+		float value[TILE_SIZE];
+		float sum[TILE_SIZE];
+		for (size_t y = y0; y < y0 + tile_h; y++)
+		{
+			float* row = out + y * out_w + x0;
+			// On even rows the even samples are in the coarse map, so only
+			// the odd ones are evaluated, 2 * step pixels apart. x0 is even.
+			bool reuse = coarse && y % 2 == 0;
+			size_t first = reuse ? x0 + 1 : x0;
+			size_t n = reuse ? tile_w / 2 : tile_w;
+			size_t sample_step = reuse ? step * 2 : step;
+
+			sumOctaves(sum, value, layers, first * step, y * step, n, sample_step, level);
+
+			if (!reuse) {
+				std::copy(sum, sum + n, row);
+				continue;
+			}
+			const float* coarse_row = coarse + (y / 2) * coarse_w + x0 / 2;
+			for (size_t j = 0; j < tile_w; j++)
+			{
+				row[j] = j % 2 == 0 ? coarse_row[j / 2] : sum[j / 2];
+			}
+		}
+		if (progress) progress->done++;
+		});
+	return !(cancel && cancel->cancelled());
+}
+
+void sampleRect(float* out, size_t out_stride, size_t x0, size_t y0, size_t width, size_t height, const std::vector<Octave>& layers) {
+	SimdLevel level = detectSimdLevel();
+	float value[TILE_SIZE];
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x += TILE_SIZE)
+		{
+			sumOctaves(out + y * out_stride + x, value, layers, x0 + x, y0 + y, std::min(TILE_SIZE, width - x), 1, level);
+		}
+	}
+}
+
+bool generateRows(float* out, size_t width, size_t y0, size_t rows, const std::vector<Octave>& layers, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	size_t tiles_w = 1 + (width - 1) / TILE_SIZE;
+	size_t tiles_h = 1 + (rows - 1) / TILE_SIZE;
+	pool.parallelFor(tiles_w * tiles_h, [&](size_t i) {
+		if (cancel && cancel->cancelled()) return;
+		size_t x0 = (i % tiles_w) * TILE_SIZE;
+		size_t ty = (i / tiles_w) * TILE_SIZE;
+		sampleRect(out + ty * width + x0, width, x0, y0 + ty, std::min(TILE_SIZE, width - x0), std::min(TILE_SIZE, rows - ty), layers);
+		if (progress) progress->done++;
+		});
+	return !(cancel && cancel->cancelled());
+}
+
+bool generateMap(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel)
+{
+	std::vector<Octave> layers;
+	if (!mapOctaves(layers, width, height, octaves, persistence, lacunarity, seed, source, noise, cancel)) return false;
+	if (progress) {
+		progress->done = 0;
+		progress->total = sampleTiles(width, height, 1);
+	}
+	return sampleOctaves(map, width, height, 1, layers, pool, nullptr, progress, cancel);
+}
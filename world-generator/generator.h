@@ -0,0 +1,146 @@
+#pragma once
+
+#include "gradients.h"
+#include "perlin_kernel.h"
+#include "simplex.h"
+#include "thread_pool.h"
+
+#include <atomic>
+
+// Edge length in pixels of the square tiles a map is split into for the
+// workers. Independent of the Perlin grid cell size.
+const size_t TILE_SIZE = 64;
+
+// Tiles of a running generateMap finished so far, readable from any thread.
+struct GenerationProgress {
+	std::atomic<size_t> done{ 0 };
+	std::atomic<size_t> total{ 0 };
+
+	float fraction() const {
+		size_t t = total.load();
+		return t == 0 ? 0.f : (float)done.load() / t;
+	}
+};
+
+// Set from any thread to make a running generation stop early. Workers
+// check it between tiles, so it takes effect within one tile's work.
+class CancellationToken {
+public:
+	void cancel() { m_cancelled = true; }
+	void reset() { m_cancelled = false; }
+	bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> m_cancelled{ false };
+};
+
+// Noise every fBm layer is made of.
+enum class NoiseBackend {
+	// Classic gradient noise on a square lattice.
+	Perlin,
+	// Gradient noise on a triangular lattice, see simplex_process_rect.
+	Simplex,
+};
+
+const size_t NOISE_BACKEND_COUNT = 2;
+
+// How a backend is evaluated. Everything that samples octaves goes through
+// these, so a new backend is an enum value and an entry in the table of
+// noiseBackend.
+struct NoiseBackendOps {
+	// Lowercase, as the CLI takes it.
+	const char* name;
+	// Largest |value| the backend returns with unit gradients.
+	float bound;
+	// Lattice points needed along each axis beyond the grid_w x grid_h
+	// square lattice that covers a map.
+	size_t (*lattice_padding)(size_t grid_w, size_t grid_h);
+	// Fills the rect perlin_process_rect would with the backend's span
+	// kernel for level.
+	void (*process_rect)(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, SimdLevel level, size_t step);
+};
+
+const NoiseBackendOps& noiseBackend(NoiseBackend noise);
+
+// Backend called name. Returns false if there is none.
+bool findNoiseBackend(const char* name, NoiseBackend& noise);
+
+// Parameters of one fBm layer of generateMap. The layer's noise depends
+// only on the seed, cell size, gradient source, backend and map size.
+struct OctaveSpec {
+	uint32_t seed;
+	size_t grid_cell_size;
+	float amplitude;
+};
+
+// The layers generateMap sums for a map of the given width. Cell sizes are
+// clamped to [1, width] for any lacunarity.
+std::vector<OctaveSpec> octaveSpecs(size_t width, size_t octaves, float persistence, float lacunarity, uint32_t seed);
+
+// One fBm layer of generateMap with its gradients and backend, looked up
+// once when the octave is built.
+struct Octave {
+	GradientField gradients;
+	size_t grid_cell_size;
+	float amplitude;
+	const NoiseBackendOps* backend;
+};
+
+// Writes the noise of octave over the rect perlin_process_rect would, with
+// the octave's backend and its kernel for level. Not scaled by the
+// amplitude.
+void octave_process_rect(float* out, size_t out_stride, const Octave& octave, int64_t x0, int64_t y0, size_t width, size_t height, SimdLevel level, size_t step = 1);
+
+// Number of samples along an edge of length pixels when every step-th pixel
+// is taken, starting with the first.
+inline size_t sampleCount(size_t length, size_t step) { return 1 + (length - 1) / step; }
+
+// Tiles sampleOctaves splits its output into.
+size_t sampleTiles(size_t width, size_t height, size_t step);
+
+// Builds the octaves generateMap sums for a width x height map into layers.
+// Returns false if cancelled.
+bool mapOctaves(std::vector<Octave>& layers, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, const CancellationToken* cancel = nullptr);
+
+// Sums layers at every step-th pixel of a width x height map in both
+// directions, writing a sampleCount(width, step) wide map to out. Each sample
+// equals the pixel of generateMap it falls on. coarse, if given, is the same
+// map sampled at 2 * step, and the samples the two share are copied from it.
+// progress is advanced per tile but not reset. Returns false if cancelled.
+bool sampleOctaves(float* out, size_t width, size_t height, size_t step, const std::vector<Octave>& layers, ThreadPool& pool, const float* coarse = nullptr, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// Writes the width x height rect at (x0, y0) of the map sampleOctaves would
+// produce at step 1 to out, rows out_stride floats apart. Runs on the
+// calling thread, for callers that hand tiles to the pool themselves.
+void sampleRect(float* out, size_t out_stride, size_t x0, size_t y0, size_t width, size_t height, const std::vector<Octave>& layers);
+
+// Writes rows y0 to y0 + rows of the width wide map sampleOctaves would
+// produce at step 1 to out, which holds just those rows. A map too large
+// for memory can be generated band by band this way; the layers should use
+// hashed gradients then, since a grid for every lattice point of such a map
+// is large too. progress is advanced per tile but not reset. Returns false
+// if cancelled.
+bool generateRows(float* out, size_t width, size_t y0, size_t rows, const std::vector<Octave>& layers, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// The same seed and parameters always produce the same map. progress, if
+// given, is reset at the start and advanced after every tile. Returns false
+// if cancel was set during the call, in which case the map may be partly
+// written.
+bool generateMap(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// Single noise layer. Passing octaveSeed(seed, i) reproduces octave i of
+// generateMap with that seed. progress is advanced per tile but not reset.
+// Returns false if cancelled like generateMap.
+bool noiseLayer(float* map, size_t width, size_t height, size_t grid_cell_size, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// noiseLayer with the Perlin backend.
+bool perlinNoise(float* map, size_t width, size_t height, size_t grid_cell_size, uint32_t seed, GradientSource source, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// Perlin noise with unit gradients stays within sqrt(2) / 2 of zero.
+const float PERLIN_BOUND = 0.70711f;
+
+// Writes the noise of width x height pixels, starting at (x0, y0) and step
+// pixels apart in both directions, to out, row by row out_stride floats apart.
+// Negative coordinates need gradients that cover them, i.e. hashed ones.
+void perlin_process_rect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, PerlinSpanKernel kernel, size_t step = 1);
+
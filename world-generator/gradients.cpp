@@ -0,0 +1,77 @@
+#include "gradients.h"
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+namespace {
+
+std::array<Vec2f, GRADIENT_TABLE_SIZE> makeGradientTable() {
+	std::array<Vec2f, GRADIENT_TABLE_SIZE> table;
+	for (size_t i = 0; i < GRADIENT_TABLE_SIZE; i++)
+	{
+		double angle = 2 * M_PI * i / GRADIENT_TABLE_SIZE - M_PI;
+		table[i] = Vec2f{ (float)cos(angle), (float)sin(angle) };
+	}
+	return table;
+}
+
+const std::array<Vec2f, GRADIENT_TABLE_SIZE> GRADIENT_TABLE = makeGradientTable();
+
+// 64-bit multiply-xorshift mix of the lattice coordinates into the seed.
+uint32_t hashLattice(uint32_t seed, int64_t x, int64_t y) {
+	uint64_t h = seed;
+	h ^= (uint64_t)x * 0x9E3779B97F4A7C15ull;
+	h = (h ^ (h >> 32)) * 0xD6E8FEB86659FD93ull;
+	h ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full;
+	h = (h ^ (h >> 32)) * 0xD6E8FEB86659FD93ull;
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+}
+
+GradientField::GradientField(GradientSource source, uint32_t seed, size_t grid_w, size_t grid_h)
+	: m_source(source), m_seed(seed), m_grid_w(grid_w) {
+	if (source == GradientSource::Grid) {
+		m_grid = perlin_random_grid(grid_w, grid_h, seed);
+	}
+}
+
+Vec2f GradientField::at(int64_t x, int64_t y) const {
+	if (m_source == GradientSource::Grid) {
+		return m_grid[y * m_grid_w + x];
+	}
+	return GRADIENT_TABLE[hashLattice(m_seed, x, y) % GRADIENT_TABLE_SIZE];
+}
+
+void GradientField::cellCorners(int64_t cx, int64_t cy, float* g) const {
+	Vec2f corners[4] = { at(cx, cy), at(cx + 1, cy), at(cx, cy + 1), at(cx + 1, cy + 1) };
+	for (size_t i = 0; i < 4; i++)
+	{
+		g[i * 2] = corners[i].x;
+		g[i * 2 + 1] = corners[i].y;
+	}
+}
+
+uint32_t octaveSeed(uint32_t seed, size_t octave) {
+	std::seed_seq seq{ seed, (uint32_t)octave };
+	uint32_t octave_seed;
+	seq.generate(&octave_seed, &octave_seed + 1);
+	return octave_seed;
+}
+
+std::vector<Vec2f> perlin_random_grid(size_t grid_w, size_t grid_h, uint32_t seed) {
+	// Angles come straight from the raw mt19937 output, which the standard
+	// pins down exactly, rather than from a distribution whose algorithm is
+	// up to the library.
+	std::mt19937 rng(seed);
+	std::vector<Vec2f> grid(grid_w * grid_h);
+	std::for_each(grid.begin(), grid.end(), [&rng](Vec2f& v) {
+		float angle = (float)(rng() * (2 * M_PI / 4294967296.0) - M_PI);
+		v.x = cos(angle);
+		v.y = sin(angle);
+		});
+	return grid;
+}
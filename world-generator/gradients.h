@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vec2f {
+	float x;
+	float y;
+};
+
+enum class GradientSource {
+	// Random gradients materialized for every lattice point of the map.
+	Grid,
+	// Gradients looked up on demand from a hash of (seed, x, y) into a small
+	// fixed table. Needs no memory and works for any lattice point.
+	Hash,
+};
+
+// Number of unit vectors the hashed source picks from.
+const size_t GRADIENT_TABLE_SIZE = 256;
+
+// Lattice gradients of one noise layer.
+class GradientField {
+public:
+	// grid_w and grid_h are the lattice size and only matter for Grid.
+	GradientField(GradientSource source, uint32_t seed, size_t grid_w = 0, size_t grid_h = 0);
+
+	Vec2f at(int64_t x, int64_t y) const;
+
+	// Gradients of the four corners of lattice cell (cx, cy) as x, y pairs:
+	// top-left, top-right, bottom-left, bottom-right.
+	void cellCorners(int64_t cx, int64_t cy, float* g) const;
+
+private:
+	GradientSource m_source;
+	uint32_t m_seed;
+	size_t m_grid_w;
+	std::vector<Vec2f> m_grid;
+};
+
+uint32_t octaveSeed(uint32_t seed, size_t octave);
+
+std::vector<Vec2f> perlin_random_grid(size_t grid_w, size_t grid_h, uint32_t seed);
@@ -0,0 +1,138 @@
+#include "heightmap_io.h"
+#include "byte_order.h"
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace {
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Returns rows y to y + rows of the map as floats, valid until the next
+// call.
+typedef std::function<const float*(size_t y, size_t rows)> StripSource;
+
+// Calls write(first_row, rows) for every strip of the map and counts the
+// rows in rows_written. Stops at the first strip that fails.
+template <typename Write>
+bool writeStrips(size_t height, std::atomic<size_t>* rows_written, Write write) {
+	for (size_t y = 0; y < height; y += EXPORT_STRIP_ROWS)
+	{
+		size_t rows = std::min(EXPORT_STRIP_ROWS, height - y);
+		if (!write(y, rows)) return false;
+		if (rows_written) *rows_written += rows;
+	}
+	return true;
+}
+
+bool writeRawFloat32(FILE* file, const StripSource& map, size_t width, size_t height, std::atomic<size_t>* rows_written) {
+	return writeStrips(height, rows_written, [&](size_t y, size_t rows) {
+		return writeRaw(file, map(y, rows), width * rows);
+		});
+}
+
+// 16-bit samples of a strip, big- or little-endian.
+void convertStrip(const float* map, size_t count, bool big_endian, uint8_t* out) {
+	for (size_t i = 0; i < count; i++)
+	{
+		uint16_t sample = heightSample16(map[i]);
+		out[i * 2] = big_endian ? sample >> 8 : sample & 0xFF;
+		out[i * 2 + 1] = big_endian ? sample & 0xFF : sample >> 8;
+	}
+}
+
+bool writeRaw16(FILE* file, const StripSource& map, size_t width, size_t height, bool big_endian, std::atomic<size_t>* rows_written) {
+	std::vector<uint8_t> strip(width * EXPORT_STRIP_ROWS * 2);
+	return writeStrips(height, rows_written, [&](size_t y, size_t rows) {
+		convertStrip(map(y, rows), width * rows, big_endian, strip.data());
+		return fwrite(strip.data(), 1, width * rows * 2, file) == width * rows * 2;
+		});
+}
+
+bool writePgm16(FILE* file, const StripSource& map, size_t width, size_t height, std::atomic<size_t>* rows_written) {
+	if (fprintf(file, "P5\n%zu %zu\n65535\n", width, height) < 0) return false;
+	// PGM samples are big-endian.
+	return writeRaw16(file, map, width, height, true, rows_written);
+}
+
+bool writePng16(FILE* file, const StripSource& map, size_t width, size_t height, std::atomic<size_t>* rows_written) {
+	PngWriter png(file, width, height, PngWriter::Format::Gray16);
+	std::vector<uint8_t> strip(width * EXPORT_STRIP_ROWS * 2);
+	bool ok = writeStrips(height, rows_written, [&](size_t y, size_t rows) {
+		convertStrip(map(y, rows), width * rows, true, strip.data());
+		return png.writeRows(strip.data(), rows);
+		});
+	return png.finish() && ok;
+}
+
+bool writeStripSource(const std::string& path, const StripSource& map, size_t width, size_t height, HeightmapFormat format, std::atomic<size_t>* rows_written) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	bool ok = false;
+	switch (format) {
+	case HeightmapFormat::RawFloat32: ok = writeRawFloat32(file, map, width, height, rows_written); break;
+	case HeightmapFormat::RawUint16: ok = writeRaw16(file, map, width, height, false, rows_written); break;
+	case HeightmapFormat::Pgm16: ok = writePgm16(file, map, width, height, rows_written); break;
+	case HeightmapFormat::Png16: ok = writePng16(file, map, width, height, rows_written); break;
+	}
+	return fclose(file) == 0 && ok;
+}
+
+}
+
+uint16_t heightSample16(float height) {
+	float value = std::min(1.f, std::max(0.f, (height + 1.f) * 0.5f));
+	return (uint16_t)(value * 65535.f + 0.5f);
+}
+
+bool heightmapFormatFromPath(const std::string& path, HeightmapFormat& format) {
+	if (endsWith(path, ".r32")) {
+		format = HeightmapFormat::RawFloat32;
+		return true;
+	}
+	if (endsWith(path, ".r16")) {
+		format = HeightmapFormat::RawUint16;
+		return true;
+	}
+	if (endsWith(path, ".pgm")) {
+		format = HeightmapFormat::Pgm16;
+		return true;
+	}
+	if (endsWith(path, ".png")) {
+		format = HeightmapFormat::Png16;
+		return true;
+	}
+	return false;
+}
+
+bool writeHeightmap(const std::string& path, const float* map, size_t width, size_t height, HeightmapFormat format, std::atomic<size_t>* rows_written) {
+	auto strip = [&](size_t y, size_t) { return map + y * width; };
+	return writeStripSource(path, strip, width, height, format, rows_written);
+}
+
+bool writeHeightmap(const std::string& path, const CompactHeightfield& map, HeightmapFormat format, std::atomic<size_t>* rows_written) {
+	size_t width = map.width();
+	std::vector<float> decoded(width * EXPORT_STRIP_ROWS);
+	auto strip = [&](size_t y, size_t rows) {
+		map.decode(y * width, width * rows, decoded.data());
+		return (const float*)decoded.data();
+	};
+	return writeStripSource(path, strip, width, map.height(), format, rows_written);
+}
+
+bool writePixelsPng(const std::string& path, const uint8_t* pixels, size_t width, size_t height, std::atomic<size_t>* rows_written) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	PngWriter png(file, width, height, PngWriter::Format::Rgba8);
+	bool ok = writeStrips(height, rows_written, [&](size_t y, size_t rows) {
+		return png.writeRows(pixels + y * width * 4, rows);
+		});
+	ok = png.finish() && ok;
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "compact_heightfield.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class HeightmapFormat {
+	// Raw little-endian float32 samples, row by row (.r32).
+	RawFloat32,
+	// Raw little-endian uint16 samples, row by row (.r16), [-1, 1] mapped to
+	// [0, 65535].
+	RawUint16,
+	// Binary 16-bit grayscale PGM (.pgm), mapped like RawUint16.
+	Pgm16,
+	// 16-bit grayscale PNG (.png), mapped like RawUint16.
+	Png16,
+};
+
+// Rows converted and written at a time. Only one strip of converted
+// samples is held in memory, whatever the map size.
+const size_t EXPORT_STRIP_ROWS = 64;
+
+// 16-bit sample of a height, [-1, 1] mapped to [0, 65535] and clamped.
+uint16_t heightSample16(float height);
+
+// Picks the format from the file extension. Returns false if unknown.
+bool heightmapFormatFromPath(const std::string& path, HeightmapFormat& format);
+
+// Returns false if the file can't be written. rows_written, if given, is
+// advanced after every strip so another thread can show progress.
+bool writeHeightmap(const std::string& path, const float* map, size_t width, size_t height, HeightmapFormat format, std::atomic<size_t>* rows_written = nullptr);
+
+// Same for a compact map, decoded a strip at a time. 16-bit formats round
+// the decoded heights again, so Uint16 samples only pass through unchanged
+// if the range is [-1, 1].
+bool writeHeightmap(const std::string& path, const CompactHeightfield& map, HeightmapFormat format, std::atomic<size_t>* rows_written = nullptr);
+
+// Writes RGBA pixels, e.g. from mapToPixels, as an 8-bit RGBA PNG. Returns
+// false if the file can't be written.
+bool writePixelsPng(const std::string& path, const uint8_t* pixels, size_t width, size_t height, std::atomic<size_t>* rows_written = nullptr);
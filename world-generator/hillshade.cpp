@@ -0,0 +1,140 @@
+#include "hillshade.h"
+#include "generator.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Sun direction as a unit vector, y pointing down the map and z up.
+struct Light {
+	float x;
+	float y;
+	float z;
+};
+
+Light sunDirection(const Hillshade& shade) {
+	const float radians = 3.14159265f / 180.f;
+	float azimuth = shade.azimuth * radians;
+	float altitude = std::min(90.f, std::max(1.f, shade.altitude)) * radians;
+	return { std::sin(azimuth) * std::cos(altitude), -std::cos(azimuth) * std::cos(altitude), std::sin(altitude) };
+}
+
+// Brightness factor of a pixel with height gradient (gx, gy): its Lambert
+// term for the normal (-gx, -gy, 1), relative to flat ground.
+inline float shadeFactor(float gx, float gy, const Hillshade& shade, const Light& light) {
+	float lambert = (light.z - gx * light.x - gy * light.y) / std::sqrt(gx * gx + gy * gy + 1.f);
+	return 1.f - shade.strength + shade.strength * std::max(0.f, lambert) / light.z;
+}
+
+// Shades pixels x0 to x1 of a row, at most TILE_SIZE long. up and down are
+// the rows above and below, or the row itself at the map edges, dy the
+// distance between them.
+void shadeRow(const float* up, const float* row, const float* down, float dy, size_t x0, size_t x1, size_t width, const Hillshade& shade, const Light& light, uint8_t* pixels) {
+	float factor[TILE_SIZE];
+	float x_scale = shade.relief * 0.5f;
+	float y_scale = shade.relief / dy;
+
+	// Interior pixels have both horizontal neighbours, so they need no
+	// clamping.
+	size_t first = std::max<size_t>(x0, 1);
+	size_t last = std::min(x1, width - 1);
+	size_t x = first;
+#ifdef WG_X86
+	const __m128 v_x_scale = _mm_set1_ps(x_scale);
+	const __m128 v_y_scale = _mm_set1_ps(y_scale);
+	const __m128 light_x = _mm_set1_ps(light.x);
+	const __m128 light_y = _mm_set1_ps(light.y);
+	const __m128 light_z = _mm_set1_ps(light.z);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 unlit = _mm_set1_ps(1.f - shade.strength);
+	const __m128 lit = _mm_set1_ps(shade.strength);
+	for (; x + 4 <= last; x += 4)
+	{
+		__m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)), v_x_scale);
+		__m128 gy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)), v_y_scale);
+		__m128 dot = _mm_sub_ps(_mm_sub_ps(light_z, _mm_mul_ps(gx, light_x)), _mm_mul_ps(gy, light_y));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), one));
+		__m128 lambert = _mm_max_ps(_mm_div_ps(dot, length), zero);
+		_mm_storeu_ps(factor + x - x0, _mm_add_ps(unlit, _mm_div_ps(_mm_mul_ps(lit, lambert), light_z)));
+	}
+#endif
+	for (; x < last; x++)
+	{
+		factor[x - x0] = shadeFactor((row[x + 1] - row[x - 1]) * x_scale, (down[x] - up[x]) * y_scale, shade, light);
+	}
+	if (x0 == 0) {
+		float gx = width > 1 ? (row[1] - row[0]) * shade.relief : 0.f;
+		factor[0] = shadeFactor(gx, (down[0] - up[0]) * y_scale, shade, light);
+	}
+	if (x1 == width && width > 1) {
+		size_t x = width - 1;
+		factor[x - x0] = shadeFactor((row[x] - row[x - 1]) * shade.relief, (down[x] - up[x]) * y_scale, shade, light);
+	}
+
+	x = x0;
+#ifdef WG_X86
+	// Four pixels are widened to floats, scaled and packed back with
+	// saturation. Alpha is kept as it was.
+	const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i zero_i = _mm_setzero_si128();
+	for (; x + 4 <= x1; x += 4)
+	{
+		__m128i rgba = _mm_loadu_si128((const __m128i*)(pixels + x * 4));
+		__m128 f = _mm_loadu_ps(factor + x - x0);
+		__m128i lo = _mm_unpacklo_epi8(rgba, zero_i);
+		__m128i hi = _mm_unpackhi_epi8(rgba, zero_i);
+		__m128i p0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero_i)), _mm_shuffle_ps(f, f, 0x00)));
+		__m128i p1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero_i)), _mm_shuffle_ps(f, f, 0x55)));
+		__m128i p2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero_i)), _mm_shuffle_ps(f, f, 0xAA)));
+		__m128i p3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero_i)), _mm_shuffle_ps(f, f, 0xFF)));
+		__m128i shaded = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+		_mm_storeu_si128((__m128i*)(pixels + x * 4), _mm_or_si128(_mm_and_si128(shaded, rgb), _mm_andnot_si128(rgb, rgba)));
+	}
+#endif
+	for (; x < x1; x++)
+	{
+		uint8_t* pixel = pixels + x * 4;
+		for (size_t c = 0; c < 3; c++)
+		{
+			pixel[c] = (uint8_t)std::min(255.f, pixel[c] * factor[x - x0]);
+		}
+	}
+}
+
+}
+
+void hillshadeRect(const float* map, size_t width, size_t height, const DirtyRect& rect, const Hillshade& shade, uint8_t* pixels, size_t p_width, ThreadPool& pool) {
+	if (rect.width == 0 || rect.height == 0) return;
+	Light light = sunDirection(shade);
+	size_t tiles_w = 1 + (rect.width - 1) / TILE_SIZE;
+	size_t tiles_h = 1 + (rect.height - 1) / TILE_SIZE;
+	pool.parallelFor(tiles_w * tiles_h, [&](size_t i) {
+		size_t x0 = rect.x + (i % tiles_w) * TILE_SIZE;
+		size_t y0 = rect.y + (i / tiles_w) * TILE_SIZE;
+		size_t x1 = std::min(x0 + TILE_SIZE, rect.x + rect.width);
+		size_t y1 = std::min(y0 + TILE_SIZE, rect.y + rect.height);
+		// The rows above and below the tile are its halo. They are read from
+		// the map directly, neighbouring tiles only write pixels.
+		for (size_t y = y0; y < y1; y++)
+		{
+			size_t above = y > 0 ? y - 1 : y;
+			size_t below = y + 1 < height ? y + 1 : y;
+			shadeRow(map + above * width, map + y * width, map + below * width, (float)std::max<size_t>(1, below - above), x0, x1, width, shade, light, pixels + y * p_width * 4);
+		}
+		});
+}
+
+void hillshade(const float* map, size_t width, size_t height, const Hillshade& shade, uint8_t* pixels, size_t p_width, ThreadPool& pool) {
+	hillshadeRect(map, width, height, { 0, 0, width, height }, shade, pixels, p_width, pool);
+}
+
+DirtyRect hillshadeHalo(const DirtyRect& rect, size_t width, size_t height) {
+	size_t x0 = rect.x > 0 ? rect.x - 1 : 0;
+	size_t y0 = rect.y > 0 ? rect.y - 1 : 0;
+	size_t x1 = std::min(width, rect.x + rect.width + 1);
+	size_t y1 = std::min(height, rect.y + rect.height + 1);
+	return { x0, y0, x1 - x0, y1 - y0 };
+}
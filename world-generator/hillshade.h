@@ -0,0 +1,34 @@
+#pragma once
+
+#include "dirty_rect.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Sun and relief of a hillshade pass.
+struct Hillshade {
+	// Direction the light comes from, in degrees clockwise from the top of
+	// the map.
+	float azimuth = 315.f;
+	// Height of the sun above the horizon in degrees.
+	float altitude = 45.f;
+	// Pixels per unit of height. Larger values make slopes steeper.
+	float relief = 200.f;
+	// 0 leaves the pixels alone, 1 shades them fully.
+	float strength = 1.f;
+};
+
+// Darkens or brightens the RGB of rect of already colorized pixels by how
+// much each pixel's slope faces the sun, relative to flat ground. Normals
+// come from central differences of map, one-sided at the map edges, so a
+// pixel depends on its neighbours just outside rect too. Work is split into
+// tiles over the pool.
+void hillshadeRect(const float* map, size_t width, size_t height, const DirtyRect& rect, const Hillshade& shade, uint8_t* pixels, size_t p_width, ThreadPool& pool);
+
+// hillshadeRect over the whole map.
+void hillshade(const float* map, size_t width, size_t height, const Hillshade& shade, uint8_t* pixels, size_t p_width, ThreadPool& pool);
+
+// rect grown by the one pixel of neighbours hillshadeRect reads, clipped to
+// the map. Shading this covers every pixel a change inside rect affects.
+DirtyRect hillshadeHalo(const DirtyRect& rect, size_t width, size_t height);
@@ -1,138 +1,30 @@
 #include "imgui.h"
 #include "imgui-SFML.h"
 
+#include "worldgen.h"
+#include "background_generator.h"
+#include "tile_cache.h"
+#include "tile_streamer.h"
+
 #define _USE_MATH_DEFINES
 #include <SFML/Graphics.hpp>
-#include <iostream>
+#include <algorithm>
 #include <random>
-#include <assert.h>
-#include <thread>
-#include <functional>
-#include <sstream>
+#include <cmath>
 
 const int WINDOW_WIDTH	= 1280;
 const int WINDOW_HEIGHT = 720;
-const size_t GRID_CELL_SIZE = 318;
-const size_t OPTIMAL_THREAD_NUM = 128;
-
-void generateMap(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity);
+// The world view's texture atlas holds ATLAS_SLOTS x ATLAS_SLOTS tiles.
+const size_t ATLAS_SLOTS = 16;
+const size_t UPLOADS_PER_FRAME = 16;
+const int64_t PREFETCH_MARGIN = 1;
+// How many levels coarser a stand-in can be for a tile not streamed yet.
+const unsigned FALLBACK_LODS = 4;
+const double MAX_ZOOM = 16;
 
-void mapToPixels(float* map, size_t width, size_t height, sf::Uint8* pixels, size_t p_width = WINDOW_WIDTH);
+int main() {
+	ThreadPool pool;
 
-template<typename T>
-inline float dotProduct(const sf::Vector2<T>& lh, const sf::Vector2<T>& rh) {
-	return lh.x * rh.x + lh.y * rh.y;
-}
-
-float smoothstep(float x) {
-	return (6 * x * x * x * x * x - 15 * x * x * x * x + 10 * x * x * x);
-	//return (3.0 - x * 2.0) * x * x;
-	//return x;
-	//return ((x * (x * 6.0 - 15.0) + 10.0) * x * x * x);
-}
-
-float interpolate(float a, float b, float w) {
-	if (0.0 > w) return a;
-	if (1.0 < w) return b;
-	return a + smoothstep(w) * (b - a);
-}
-
-void perlin_process_fraction(float* map, size_t map_width, sf::Vector2f* grid, size_t size, size_t off_x, size_t off_y, size_t grid_w, size_t width = 0, size_t height = 0) {
-	if (width == 0 && height == 0) { 
-		width = height = size;
-	}
-	for (size_t i = 0; i < height; i++)
-	{
-		for (size_t j = 0; j < width; j++)
-		{
-			sf::Vector2f point(j, i);
-
-			size_t absolute_y = (i + off_y * size) / size;
-			size_t absolute_x = (j + off_x * size) / size;
-			sf::Vector2f* top_left		= grid + ( absolute_y      * grid_w + absolute_x);
-			sf::Vector2f* top_right		= grid + ( absolute_y      * grid_w + absolute_x + 1);
-			sf::Vector2f* bottom_left	= grid + ((absolute_y + 1) * grid_w + absolute_x);
-			sf::Vector2f* bottom_right	= grid + ((absolute_y + 1) * grid_w + absolute_x + 1);
-
-			sf::Vector2f relative_point		 = point / (float)size;
-			sf::Vector2f top_left_offset	 = relative_point;
-			sf::Vector2f top_right_offset	 = relative_point - sf::Vector2f(1.f, 0.f);
-			sf::Vector2f bottom_left_offset	 = relative_point - sf::Vector2f(0.f, 1.f);
-			sf::Vector2f bottom_right_offset = relative_point - sf::Vector2f(1.f, 1.f);
-
-
-			float top_left_dp	  = dotProduct(top_left_offset,		*top_left);
-			float top_right_dp	  = dotProduct(top_right_offset,	*top_right);
-			float bottom_left_dp  = dotProduct(bottom_left_offset,	*bottom_left);
-			float bottom_right_dp = dotProduct(bottom_right_offset, *bottom_right);
-
-			float sx = (float)j / size;
-			float sy = (float)i / size;
-
-			float n0 = interpolate(top_left_dp, top_right_dp, sx);
-			float n1 = interpolate(bottom_left_dp, bottom_right_dp, sx);
-			float value = interpolate(n0, n1, sy);
-			map[(off_y * size + i) * map_width + (off_x * size + j)] = value;
-		}
-	}
-}
-
-void perlin_process_blocks(float* map, size_t map_width, size_t map_height, sf::Vector2f* grid, size_t size, size_t off, size_t n) {
-	size_t grid_cell_w = 1 + (map_width - 1) / size;
-	size_t grid_w = grid_cell_w + 1;
-	for (size_t i = 0; i < n; i++)
-	{
-		size_t block_offset_x = (off + i) % grid_cell_w;
-		size_t block_offset_y = (off + i) / grid_cell_w;
-		size_t width = std::min(size, map_width - (block_offset_x) * size);
-		size_t height = std::min(size, map_height - (block_offset_y) * size);
-		perlin_process_fraction(map, map_width, grid, size, block_offset_x, block_offset_y, grid_w, width, height);
-	}
-}
-
-void perlinNoise(float* map, size_t width, size_t height, size_t grid_cell_size) {
-	size_t grid_cell_w = 1 + (width - 1) / grid_cell_size;
-	size_t grid_cell_h = 1 + (height - 1) / grid_cell_size;
-	size_t grid_w = grid_cell_w + 1;
-	size_t grid_h = grid_cell_h + 1;
-
-	std::random_device dev;
-	std::mt19937 rng(dev());
-	std::uniform_real_distribution<double> dist(-M_PI, M_PI);
-	sf::Vector2f* grid = new sf::Vector2f[grid_w * grid_h];
-	std::for_each(grid, grid + grid_w * grid_h, [&dist, &rng](sf::Vector2f& v) {
-		float angle = dist(rng);
-		v.x = cos(angle);
-		v.y = sin(angle);
-		});
-
-	size_t blocks_n = grid_cell_h * grid_cell_w;
-	size_t block_per_thread = blocks_n / OPTIMAL_THREAD_NUM;
-	size_t last_thread_blocks = blocks_n - block_per_thread * OPTIMAL_THREAD_NUM;
-	size_t threads_n = block_per_thread == 0 ? 0 : OPTIMAL_THREAD_NUM;
-
-	std::vector<std::thread> threads(threads_n);
-	for (size_t i = 0; i < threads_n; i++)
-	{
-		size_t off = i * block_per_thread;
-		threads[i] = std::thread(perlin_process_blocks, map, width, height, grid, grid_cell_size, off, block_per_thread);
-	}
-	if (last_thread_blocks != 0) {
-		size_t off = blocks_n - last_thread_blocks;
-		perlin_process_blocks(map, width, height, grid, grid_cell_size, off, last_thread_blocks);
-	}
-	std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-}
-
-size_t autoWidth(size_t max = WINDOW_WIDTH) {
-	return max / GRID_CELL_SIZE * GRID_CELL_SIZE;
-}
-
-size_t autoHeight(size_t max = WINDOW_HEIGHT) {
-	return max / GRID_CELL_SIZE * GRID_CELL_SIZE;
-}
-
-int main(int argc, char** argv) {
 	sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "wg");
 	window.setVerticalSyncEnabled(true);
 	window.setKeyRepeatEnabled(false);
@@ -143,18 +35,21 @@ int main(int argc, char** argv) {
 	char windowTitle[] = "World Designer";
 	window.setTitle(windowTitle);
 
-	float* map = new float[WINDOW_WIDTH * WINDOW_HEIGHT] { 0 };
-	sf::Uint8* pixels = new sf::Uint8[WINDOW_WIDTH * WINDOW_HEIGHT * 4]{ 0 };
-	for (size_t i = 0; i < WINDOW_HEIGHT; i++)
-	{
-		for (size_t j = 0; j < WINDOW_WIDTH; j++)
-		{
-			pixels[(i * WINDOW_WIDTH + j) * 4 + 3] = 255;
-		}
-	}
-
 	const size_t map_width = WINDOW_WIDTH;
 	const size_t map_height = WINDOW_HEIGHT;
+
+	std::vector<float> map;
+	std::vector<uint8_t> pixels;
+	std::vector<DirtyRect> dirty;
+	std::vector<uint8_t> upload;
+	size_t uploaded_pixels = 0;
+	BackgroundGenerator generator(map_width, map_height, pool);
+	TileCache tile_cache;
+	int tile_cache_mb = (int)(DEFAULT_TILE_CACHE_BYTES >> 20);
+	TileStreamer streamer(tile_cache, pool);
+	TileAtlas atlas(ATLAS_SLOTS, ATLAS_SLOTS);
+	sf::Texture atlasTex;
+	atlasTex.create(ATLAS_SLOTS * CHUNK_SIZE, ATLAS_SLOTS * CHUNK_SIZE);
 	
 	sf::Texture mapTex;
 	mapTex.create(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -165,6 +60,31 @@ int main(int argc, char** argv) {
 	int octaves = 1;
 	float persistance = 0.5f;
 	float lacunarity = 2.0f;
+	int seed = 0;
+	bool hashed_gradients = false;
+	// Index into NoiseBackend.
+	int noise_backend = 0;
+	bool biome_colors = false;
+	std::vector<ColorStop> color_stops = biomeStops();
+	bool shaded = false;
+	Hillshade hillshade;
+	MapExporter exporter;
+	char heightmap_path[256] = "heightmap.png";
+	char image_path[256] = "map.png";
+	tile_cache.setWorld(std::make_shared<World>(octaves, persistance, lacunarity, seed, NoiseBackend::Perlin, map_width));
+
+	// World view camera: world pixel at the window's top-left corner and
+	// screen pixels per world pixel.
+	bool world_view = false;
+	// Set when parameters or colors change. The tiles are only thrown away
+	// once the world view is on, so toggling it off keeps them cached.
+	bool world_stale = false;
+	bool tiles_stale = false;
+	double view_x = 0;
+	double view_y = 0;
+	double zoom = 1;
+	bool dragging = false;
+	sf::Vector2i drag_from;
 
 	sf::Clock deltaClock;
 	while (window.isOpen()) {
@@ -175,34 +95,208 @@ int main(int argc, char** argv) {
 			if (event.type == event.Closed) {
 				window.close();
 			}
+			if (!world_view || ImGui::GetIO().WantCaptureMouse) continue;
+			if (event.type == event.MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+				dragging = true;
+				drag_from = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+			}
+			if (event.type == event.MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
+				dragging = false;
+			}
+			if (event.type == event.MouseMoved && dragging) {
+				view_x -= (event.mouseMove.x - drag_from.x) / zoom;
+				view_y -= (event.mouseMove.y - drag_from.y) / zoom;
+				drag_from = sf::Vector2i(event.mouseMove.x, event.mouseMove.y);
+			}
+			if (event.type == event.MouseWheelScrolled) {
+				// Zoom about the cursor, keeping the world point under it fixed.
+				double wx = view_x + event.mouseWheelScroll.x / zoom;
+				double wy = view_y + event.mouseWheelScroll.y / zoom;
+				zoom = std::max(1.0 / ((int64_t)1 << MAX_LOD), std::min(MAX_ZOOM, zoom * std::pow(1.25, event.mouseWheelScroll.delta)));
+				view_x = wx - event.mouseWheelScroll.x / zoom;
+				view_y = wy - event.mouseWheelScroll.y / zoom;
+			}
 		}
 		ImGui::SFML::Update(window, deltaClock.restart());
 		ImGui::Begin("Sample window");
-		if (ImGui::InputInt("Ocatves", &octaves)) {
-			generateMap(map, map_width, map_height, octaves, persistance, lacunarity);
-			mapToPixels(map, map_width, map_height, pixels);
-			mapTex.update(pixels);
+		// Widgets only queue a generation. The window keeps showing the last
+		// finished map until the generator hands over a newer one.
+		bool changed = false;
+		changed |= ImGui::InputInt("Ocatves", &octaves);
+		changed |= ImGui::SliderFloat("Persistance", &persistance, 0.f, 1.f);
+		changed |= ImGui::SliderFloat("Lacunarity", &lacunarity, 1.f, 4.f);
+		changed |= ImGui::InputInt("Seed", &seed);
+		changed |= ImGui::Checkbox("Hashed gradients", &hashed_gradients);
+		changed |= ImGui::Combo("Noise", &noise_backend, [](void*, int i, const char** name) {
+			*name = noiseBackend((NoiseBackend)i).name;
+			return true;
+			}, nullptr, (int)NOISE_BACKEND_COUNT);
+		if(ImGui::Button("Generate")) {
+			seed = (int)std::random_device()();
+			changed = true;
 		}
-		if (ImGui::SliderFloat("Persistance", &persistance, 0.f, 1.f)) {
-			generateMap(map, map_width, map_height, octaves, persistance, lacunarity);
-				mapToPixels(map, map_width, map_height, pixels);
-				mapTex.update(pixels);
+		if (changed) {
+			octaves = std::max(0, octaves);
+			MapParams params;
+			params.octaves = octaves;
+			params.persistence = persistance;
+			params.lacunarity = lacunarity;
+			params.seed = seed;
+			params.source = hashed_gradients ? GradientSource::Hash : GradientSource::Grid;
+			params.noise = (NoiseBackend)noise_backend;
+			generator.request(params);
+			world_stale = true;
 		}
-		if (ImGui::SliderFloat("Lacunarity", &lacunarity, 1.f, 4.f)) {
-			generateMap(map, map_width, map_height, octaves, persistance, lacunarity);
-				mapToPixels(map, map_width, map_height, pixels);
-				mapTex.update(pixels);
+		ImGui::Checkbox("World view", &world_view);
+		if (generator.busy()) {
+			ImGui::ProgressBar(generator.progress());
 		}
-		if(ImGui::Button("Generate")) {
-			generateMap(map, map_width, map_height, octaves, persistance, lacunarity);
-			mapToPixels(map, map_width, map_height, pixels);
-			mapTex.update(pixels);
+		ImGui::Text("Last upload: %.0f%% of the map", 100.0 * uploaded_pixels / (map_width * map_height));
+		Viewport view{ view_x, view_y, WINDOW_WIDTH / zoom, WINDOW_HEIGHT / zoom, zoom };
+		unsigned lod = lodForZoom(zoom);
+		std::vector<TileKey> wanted;
+		if (world_view) {
+			ImGui::Text("Drag to pan, scroll to zoom. Gradients are always hashed.");
+			ImGui::Text("Zoom %.4f, level of detail %u, %zu tiles streaming", zoom, lod, streamer.pending());
+			if (world_stale) {
+				tile_cache.setWorld(std::make_shared<World>(octaves, persistance, lacunarity, seed, (NoiseBackend)noise_backend, map_width));
+				world_stale = false;
+				tiles_stale = true;
+			}
+			if (tiles_stale) {
+				streamer.reset();
+				atlas.clear();
+				tiles_stale = false;
+			}
+
+			// Tiles already in the atlas aren't streamed again. The rest are
+			// generated nearest to the centre first.
+			wanted = tilesToStream(view, lod, PREFETCH_MARGIN);
+			std::vector<TileKey> missing;
+			for (const TileKey& key : wanted) {
+				size_t slot;
+				if (!atlas.find(key, slot)) missing.push_back(key);
+			}
+			streamer.request(missing);
+			for (TileStreamer::Ready& ready : streamer.takeReady(UPLOADS_PER_FRAME)) {
+				size_t slot = atlas.insert(ready.key);
+				atlasTex.update(ready.pixels.data(), CHUNK_SIZE, CHUNK_SIZE, (unsigned)atlas.slotX(slot), (unsigned)atlas.slotY(slot));
+			}
+		}
+		if (ImGui::CollapsingHeader("Tile cache")) {
+			if (ImGui::SliderInt("Budget, MB", &tile_cache_mb, 16, 4096)) {
+				tile_cache.setBudget((size_t)tile_cache_mb << 20);
+			}
+			TileCacheStats stats = tile_cache.stats();
+			size_t lookups = stats.hits + stats.misses;
+			ImGui::Text("%zu tiles, %.1f of %.1f MB", stats.tiles, stats.bytes / 1048576.0, stats.budget / 1048576.0);
+			ImGui::Text("%zu hits, %zu misses (%.1f%% hit rate)", stats.hits, stats.misses, lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups);
+			ImGui::Text("%zu evictions", stats.evictions);
+		}
+		// The colormap is a lookup table on top of the generated heights, so
+		// editing it only recolors what is already there.
+		if (ImGui::CollapsingHeader("Colormap")) {
+			bool recolor = ImGui::Checkbox("Biome colors", &biome_colors);
+			if (biome_colors) {
+				for (size_t i = 0; i < color_stops.size(); i++)
+				{
+					ImGui::PushID((int)i);
+					recolor |= ImGui::ColorEdit3("##color", color_stops[i].color, ImGuiColorEditFlags_NoInputs);
+					ImGui::SameLine();
+					recolor |= ImGui::SliderFloat(color_stops[i].name.c_str(), &color_stops[i].height, -1.f, 1.f);
+					ImGui::PopID();
+				}
+				if (ImGui::Button("Reset colors")) {
+					color_stops = biomeStops();
+					recolor = true;
+				}
+			}
+			if (recolor) {
+				std::shared_ptr<const Colormap> colormap;
+				if (biome_colors) colormap = std::make_shared<Colormap>(color_stops);
+				generator.setColormap(colormap);
+				streamer.setColormap(colormap);
+				tiles_stale = true;
+			}
+		}
+		if (ImGui::CollapsingHeader("Hillshade")) {
+			bool reshade = ImGui::Checkbox("Shade map", &shaded);
+			reshade |= ImGui::SliderFloat("Sun azimuth", &hillshade.azimuth, 0.f, 360.f);
+			reshade |= ImGui::SliderFloat("Sun altitude", &hillshade.altitude, 1.f, 90.f);
+			reshade |= ImGui::SliderFloat("Relief", &hillshade.relief, 1.f, 2000.f, "%.0f", ImGuiSliderFlags_Logarithmic);
+			reshade |= ImGui::SliderFloat("Strength", &hillshade.strength, 0.f, 1.f);
+			if (reshade) generator.setHillshade(shaded, hillshade);
+		}
+		if (ImGui::CollapsingHeader("Export")) {
+			ImGui::InputText("Heightmap file", heightmap_path, sizeof(heightmap_path));
+			ImGui::TextDisabled(".png (16-bit), .r16, .r32 or .pgm");
+			ImGui::InputText("Image file", image_path, sizeof(image_path));
+			// The exporter takes the buffers over instead of copying them.
+			// takeResult fills new ones on the next frame.
+			ImGui::BeginDisabled(exporter.busy() || map.empty());
+			if (ImGui::Button("Save heightmap")) {
+				if (!exporter.exportHeightmap(heightmap_path, std::make_shared<const std::vector<float>>(std::move(map)), map_width, map_height)) {
+					ImGui::OpenPopup("Unknown format");
+				}
+				map.clear();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Save image")) {
+				exporter.exportPixels(image_path, std::make_shared<const std::vector<uint8_t>>(std::move(pixels)), map_width, map_height);
+				pixels.clear();
+			}
+			ImGui::EndDisabled();
+			if (exporter.busy()) {
+				ImGui::ProgressBar(exporter.progress());
+			}
+			ImGui::TextUnformatted(exporter.status().c_str());
+			if (ImGui::BeginPopup("Unknown format")) {
+				ImGui::Text("Heightmap files must end in .png, .r16, .r32 or .pgm");
+				ImGui::EndPopup();
+			}
 		}
 		ImGui::End(); 
 
+		// Only the parts of the map that changed are uploaded. Full-width
+		// rects are contiguous in pixels, the rest are packed first.
+		if (generator.takeResult(map, pixels, dirty)) {
+			uploaded_pixels = 0;
+			for (const DirtyRect& rect : dirty) {
+				const uint8_t* data = pixels.data() + rect.y * map_width * 4;
+				if (rect.width != map_width) {
+					upload.resize(rect.width * rect.height * 4);
+					extractRect(pixels.data(), map_width, rect, upload.data());
+					data = upload.data();
+				}
+				mapTex.update(data, (unsigned)rect.width, (unsigned)rect.height, (unsigned)rect.x, (unsigned)rect.y);
+				uploaded_pixels += rect.width * rect.height;
+			}
+		}
+
 		window.clear(sf::Color::White);
 
-		window.draw(s);
+		if (!world_view) {
+			window.draw(s);
+		}
+		for (const TileKey& key : wanted) {
+			// Until a tile is streamed, part of a coarser one stands in.
+			for (unsigned d = 0; d <= FALLBACK_LODS && key.lod + d <= MAX_LOD; d++)
+			{
+				TileKey coarse{ coarserTile(key.cx, d), coarserTile(key.cy, d), key.lod + d };
+				size_t slot;
+				if (!atlas.find(coarse, slot)) continue;
+				int size = (int)(CHUNK_SIZE >> d);
+				int off_x = (int)(key.cx - coarse.cx * ((int64_t)1 << d)) * size;
+				int off_y = (int)(key.cy - coarse.cy * ((int64_t)1 << d)) * size;
+				sf::Sprite tile(atlasTex, sf::IntRect((int)atlas.slotX(slot) + off_x, (int)atlas.slotY(slot) + off_y, size, size));
+				double extent = (double)World::tileExtent(key.lod);
+				tile.setPosition((float)((key.cx * extent - view_x) * zoom), (float)((key.cy * extent - view_y) * zoom));
+				float tile_scale = (float)(extent * zoom / size);
+				tile.setScale(tile_scale, tile_scale);
+				window.draw(tile);
+				break;
+			}
+		}
 		
 		ImGui::SFML::Render(window); 
 		
@@ -210,37 +304,3 @@ int main(int argc, char** argv) {
 	}
 	return 0;
 }
-
-void generateMap(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity)
-{
-	float frequency = 2;
-	float amplitude = 0.5;
-	float* temp_map = new float[width * height];
-	memset(map, 0, sizeof(float) * width * height);
-
-	for (size_t i = 0; i < octaves; i++) {
-		frequency *= lacunarity;
-		amplitude *= persistence;
-		perlinNoise(temp_map, width, height, std::max(1.f, width / frequency));
-		for (size_t j = 0; j < width*height; j++)
-		{
-			map[j] += temp_map[j] * amplitude;
-		}
-	}
-	delete[] temp_map;
-	
-}
-
-void mapToPixels(float* map, size_t width, size_t height, sf::Uint8* pixels, size_t p_width)
-{
-	for (size_t i = 0; i < height; i++)
-	{
-		for (size_t j = 0; j < width; j++)
-		{
-			float color = ((map[i * width + j] + 1.f) * 0.5) * 255;
-			pixels[(i * p_width + j) * 4]	  = color;
-			pixels[(i * p_width + j) * 4 + 1] = color;
-			pixels[(i * p_width + j) * 4 + 2] = color;
-		}
-	}
-}
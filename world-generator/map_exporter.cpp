@@ -0,0 +1,79 @@
+#include "map_exporter.h"
+
+MapExporter::MapExporter() {
+	m_worker = std::thread(&MapExporter::workerLoop, this);
+}
+
+MapExporter::~MapExporter() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	m_worker.join();
+}
+
+bool MapExporter::exportHeightmap(const std::string& path, std::shared_ptr<const std::vector<float>> map, size_t width, size_t height) {
+	HeightmapFormat format;
+	if (!heightmapFormatFromPath(path, format)) return false;
+	return start({ path, std::move(map), nullptr, format, width, height });
+}
+
+bool MapExporter::exportPixels(const std::string& path, std::shared_ptr<const std::vector<uint8_t>> pixels, size_t width, size_t height) {
+	return start({ path, nullptr, std::move(pixels), HeightmapFormat::Png16, width, height });
+}
+
+bool MapExporter::start(Job job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_busy) return false;
+		m_rows_written = 0;
+		m_rows = job.height;
+		m_job = std::move(job);
+		m_has_job = true;
+		m_busy = true;
+	}
+	m_cv.notify_all();
+	return true;
+}
+
+bool MapExporter::busy() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_busy;
+}
+
+float MapExporter::progress() const {
+	size_t rows = m_rows.load();
+	return rows == 0 ? 0.f : (float)m_rows_written.load() / rows;
+}
+
+std::string MapExporter::status() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_status;
+}
+
+void MapExporter::workerLoop() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_stop || m_has_job; });
+			// A job already handed over is still written, so nothing the
+			// caller was told has started gets lost.
+			if (!m_has_job) return;
+			job = std::move(m_job);
+			m_has_job = false;
+		}
+
+		bool ok = job.map
+			? writeHeightmap(job.path, job.map->data(), job.width, job.height, job.format, &m_rows_written)
+			: writePixelsPng(job.path, job.pixels->data(), job.width, job.height, &m_rows_written);
+		// Releases the buffers before the caller can see the export is done.
+		job.map.reset();
+		job.pixels.reset();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_status = (ok ? "Wrote " : "Failed to write ") + job.path;
+		m_busy = false;
+	}
+}
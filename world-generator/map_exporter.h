@@ -0,0 +1,67 @@
+#pragma once
+
+#include "heightmap_io.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes heightmaps and images to disk on its own thread, so the caller
+// keeps running while a large map is saved. One export runs at a time.
+// Buffers are shared rather than copied: the caller hands over ones it
+// won't write to anymore.
+class MapExporter {
+public:
+	MapExporter();
+	// Waits for a running export to finish.
+	~MapExporter();
+
+	MapExporter(const MapExporter&) = delete;
+	MapExporter& operator=(const MapExporter&) = delete;
+
+	// Starts writing map in the format named by the extension of path.
+	// Returns false, starting nothing, if an export is running or the
+	// extension is unknown.
+	bool exportHeightmap(const std::string& path, std::shared_ptr<const std::vector<float>> map, size_t width, size_t height);
+
+	// Starts writing RGBA pixels as a PNG. Returns false, starting nothing,
+	// if an export is running.
+	bool exportPixels(const std::string& path, std::shared_ptr<const std::vector<uint8_t>> pixels, size_t width, size_t height);
+
+	// True while an export is waiting or running.
+	bool busy() const;
+
+	// Part of the running export's rows written so far, in [0, 1].
+	float progress() const;
+
+	// Outcome of the last finished export, empty before the first one.
+	std::string status() const;
+
+private:
+	struct Job {
+		std::string path;
+		std::shared_ptr<const std::vector<float>> map;
+		std::shared_ptr<const std::vector<uint8_t>> pixels;
+		HeightmapFormat format;
+		size_t width;
+		size_t height;
+	};
+
+	bool start(Job job);
+	void workerLoop();
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	bool m_busy = false;
+	bool m_has_job = false;
+	Job m_job;
+	std::string m_status;
+	std::atomic<size_t> m_rows_written{ 0 };
+	std::atomic<size_t> m_rows{ 0 };
+	std::thread m_worker;
+};
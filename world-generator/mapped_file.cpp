@@ -0,0 +1,120 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::create(const std::string& path, size_t size) {
+	return map(true, path, size);
+}
+
+bool MappedFile::open(const std::string& path) {
+	return map(false, path, 0);
+}
+
+#ifdef _WIN32
+
+bool MappedFile::map(bool create, const std::string& path, size_t size) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER file_size;
+	if (!create) {
+		if (!GetFileSizeEx(file, &file_size)) {
+			CloseHandle(file);
+			return false;
+		}
+		size = (size_t)file_size.QuadPart;
+	}
+	file_size.QuadPart = (LONGLONG)size;
+	// A mapping of a given size grows the file to it.
+	HANDLE mapping = size == 0 ? nullptr : CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(file_size.QuadPart >> 32), (DWORD)file_size.QuadPart, nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+	if (!data) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_data = (uint8_t*)data;
+	m_size = size;
+	return true;
+}
+
+bool MappedFile::close() {
+	if (!m_data) return true;
+	bool ok = FlushViewOfFile(m_data, 0) != 0;
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	ok = FlushFileBuffers(m_file) != 0 && ok;
+	CloseHandle(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+	return ok;
+}
+
+bool MappedFile::flushAsync(size_t offset, size_t size) {
+	// FlushViewOfFile starts the writes and returns without waiting for the
+	// disk.
+	return !m_data || FlushViewOfFile(m_data + offset, size) != 0;
+}
+
+#else
+
+bool MappedFile::map(bool create, const std::string& path, size_t size) {
+	close();
+	int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+	if (fd < 0) return false;
+	struct stat st;
+	bool ok = create ? ftruncate(fd, (off_t)size) == 0 : fstat(fd, &st) == 0;
+	if (ok && !create) size = (size_t)st.st_size;
+	void* data = ok && size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if (data == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+	m_fd = fd;
+	m_data = (uint8_t*)data;
+	m_size = size;
+	return true;
+}
+
+bool MappedFile::close() {
+	if (!m_data) return true;
+	bool ok = msync(m_data, m_size, MS_SYNC) == 0;
+	munmap(m_data, m_size);
+	ok = ::close(m_fd) == 0 && ok;
+	m_data = nullptr;
+	m_size = 0;
+	m_fd = -1;
+	return ok;
+}
+
+bool MappedFile::flushAsync(size_t offset, size_t size) {
+	if (!m_data) return true;
+#ifdef __linux__
+	// MS_ASYNC is a no-op on Linux, this actually queues the writes.
+	return sync_file_range(m_fd, (off_t)offset, (off_t)size, SYNC_FILE_RANGE_WRITE) == 0;
+#else
+	// msync wants a page-aligned start.
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = offset / page * page;
+	return msync(m_data + start, offset + size - start, MS_ASYNC) == 0;
+#endif
+}
+
+#endif
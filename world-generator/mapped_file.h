@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A file mapped into memory for reading and writing. Pages are loaded and
+// written back by the OS as they are touched, so a file much larger than
+// RAM can be filled through the pointer without swapping.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Creates or truncates path to size bytes and maps it. Returns false if
+	// that fails.
+	bool create(const std::string& path, size_t size);
+
+	// Maps an existing file whole. Returns false if that fails.
+	bool open(const std::string& path);
+
+	// Writes the mapping back and unmaps it. Returns false if writing back
+	// failed. Called by the destructor, which ignores the result.
+	bool close();
+
+	// Starts writing back size bytes at offset without waiting, so dirty
+	// pages don't pile up while a large file is filled front to back.
+	// Returns false if the OS reports an error, e.g. from an earlier write.
+	bool flushAsync(size_t offset, size_t size);
+
+	uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	bool map(bool create, const std::string& path, size_t size);
+
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
@@ -0,0 +1,87 @@
+#include "mapped_heightmap.h"
+#include "byte_order.h"
+#include "heightmap_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char MAGIC[4] = { 'W', 'G', 'H', 'M' };
+const uint32_t VERSION = 1;
+static_assert(sizeof(MappedHeightmapHeader) == 32, "the header layout is part of the file format");
+
+}
+
+bool MappedHeightmap::create(const std::string& path, size_t width, size_t height, SampleType type) {
+	m_width = width;
+	m_height = height;
+	m_type = type;
+	if (!m_file.create(path, sizeof(MappedHeightmapHeader) + width * height * sampleSize())) return false;
+
+	MappedHeightmapHeader header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.sample_type = (uint32_t)type;
+	header.header_size = sizeof(MappedHeightmapHeader);
+	header.width = width;
+	header.height = height;
+	copyRaw(m_file.data(), &header, 1);
+	return true;
+}
+
+bool MappedHeightmap::open(const std::string& path) {
+	if (!m_file.open(path)) return false;
+	MappedHeightmapHeader header;
+	bool ok = m_file.size() >= sizeof(header);
+	if (ok) memcpy(&header, m_file.data(), sizeof(header));
+	ok = ok && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION
+		&& header.header_size == sizeof(header) && header.sample_type <= (uint32_t)SampleType::Uint16;
+	if (ok) {
+		m_width = (size_t)header.width;
+		m_height = (size_t)header.height;
+		m_type = (SampleType)header.sample_type;
+		ok = m_file.size() >= sizeof(header) + m_width * m_height * sampleSize();
+	}
+	if (!ok) m_file.close();
+	return ok;
+}
+
+bool MappedHeightmap::flushRows(size_t y0, size_t rows) {
+	size_t row_bytes = m_width * sampleSize();
+	return m_file.flushAsync(sizeof(MappedHeightmapHeader) + y0 * row_bytes, rows * row_bytes);
+}
+
+bool generateMapToFile(MappedHeightmap& out, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	size_t width = out.width();
+	size_t height = out.height();
+	std::vector<Octave> layers;
+	if (!mapOctaves(layers, width, height, octaves, persistence, lacunarity, seed, source, noise, cancel)) return false;
+	if (progress) {
+		progress->done = 0;
+		progress->total = sampleTiles(width, height, 1);
+	}
+
+	bool floats = out.sampleType() == SampleType::Float32;
+	std::vector<float> band(floats ? 0 : width * TILE_SIZE);
+	for (size_t y = 0; y < height; y += TILE_SIZE)
+	{
+		size_t rows = std::min(TILE_SIZE, height - y);
+		float* target = floats ? (float*)out.row(y) : band.data();
+		if (!generateRows(target, width, y, rows, layers, pool, progress, cancel)) return false;
+		if (!floats) {
+			// Converted a row per task, like generateCompactMap encodes.
+			pool.parallelFor(rows, [&](size_t row) {
+				uint16_t* samples = (uint16_t*)out.row(y + row);
+				const float* heights = band.data() + row * width;
+				for (size_t x = 0; x < width; x++)
+				{
+					samples[x] = heightSample16(heights[x]);
+				}
+				});
+		}
+		if (!out.flushRows(y, rows)) return false;
+	}
+	return true;
+}
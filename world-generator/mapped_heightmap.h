@@ -0,0 +1,68 @@
+#pragma once
+
+#include "generator.h"
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class SampleType : uint32_t {
+	Float32 = 0,
+	// [-1, 1] mapped to [0, 65535] like the 16-bit export formats.
+	Uint16 = 1,
+};
+
+// Start of a mapped heightmap file, little-endian. The samples follow at
+// header_size, row by row.
+struct MappedHeightmapHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t sample_type;
+	uint32_t header_size;
+	uint64_t width;
+	uint64_t height;
+};
+
+// A heightmap kept in a memory-mapped file rather than in RAM, for maps
+// larger than memory.
+class MappedHeightmap {
+public:
+	// Creates or truncates path with a header and room for every sample.
+	// Returns false if the file can't be created or mapped.
+	bool create(const std::string& path, size_t width, size_t height, SampleType type);
+
+	// Maps a file written by create. Returns false if it can't be mapped or
+	// isn't a mapped heightmap.
+	bool open(const std::string& path);
+
+	// Writes everything back and unmaps the file. Returns false if writing
+	// back failed.
+	bool close() { return m_file.close(); }
+
+	size_t width() const { return m_width; }
+	size_t height() const { return m_height; }
+	SampleType sampleType() const { return m_type; }
+	size_t sampleSize() const { return m_type == SampleType::Float32 ? sizeof(float) : sizeof(uint16_t); }
+
+	// Row y starts width * sampleSize() bytes after row y - 1.
+	uint8_t* row(size_t y) const { return m_file.data() + sizeof(MappedHeightmapHeader) + y * m_width * sampleSize(); }
+
+	// Starts writing rows y0 to y0 + rows back to disk. Returns false if
+	// that fails.
+	bool flushRows(size_t y0, size_t rows);
+
+private:
+	MappedFile m_file;
+	size_t m_width = 0;
+	size_t m_height = 0;
+	SampleType m_type = SampleType::Float32;
+};
+
+// Generates the map generateMap would produce straight into out, TILE_SIZE
+// rows at a time. Float samples are written through the mapping, uint16
+// ones are converted on the pool from a buffer of one band. Each finished band is
+// handed to the OS to write back, so only the layers and a band have to fit
+// in memory. Use hashed gradients for maps this large. progress is as for
+// generateMap. Returns false if cancelled or if writing a band back failed.
+bool generateMapToFile(MappedHeightmap& out, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
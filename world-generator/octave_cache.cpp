@@ -0,0 +1,97 @@
+#include "octave_cache.h"
+
+#include <algorithm>
+
+OctaveCache::OctaveCache(size_t width, size_t height, size_t max_layers)
+	: m_width(width), m_height(height), m_max_layers(max_layers) {
+}
+
+size_t OctaveCache::find(const OctaveSpec& spec, GradientSource source, NoiseBackend noise) const {
+	for (size_t i = 0; i < m_layers.size(); i++)
+	{
+		const Layer& layer = m_layers[i];
+		if (layer.seed == spec.seed && layer.grid_cell_size == spec.grid_cell_size && layer.source == source && layer.noise == noise) return i;
+	}
+	return m_layers.size();
+}
+
+size_t OctaveCache::missingLayers(size_t octaves, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise) const {
+	// Persistence only scales the layers, so any value will do.
+	size_t missing = 0;
+	for (const OctaveSpec& spec : octaveSpecs(m_width, octaves, 1.f, lacunarity, seed)) {
+		if (find(spec, source, noise) == m_layers.size()) missing++;
+	}
+	return missing;
+}
+
+size_t OctaveCache::progressTiles(size_t octaves, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise) const {
+	size_t bands = 1 + (m_height - 1) / TILE_SIZE;
+	return sampleTiles(m_width, m_height, 1) * missingLayers(octaves, lacunarity, seed, source, noise) + bands;
+}
+
+bool OctaveCache::generate(float* map, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	std::vector<OctaveSpec> specs = octaveSpecs(m_width, octaves, persistence, lacunarity, seed);
+	size_t bands = 1 + (m_height - 1) / TILE_SIZE;
+	size_t stamp = ++m_clock;
+
+	// Cached layers are marked in use first, so making room for the missing
+	// ones never drops them.
+	std::vector<const float*> values(specs.size(), nullptr);
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		size_t index = find(specs[i], source, noise);
+		if (index == m_layers.size()) continue;
+		m_layers[index].last_used = stamp;
+		values[i] = m_layers[index].values.data();
+	}
+	// Layers that don't fit next to the ones in use are only kept until the
+	// map is summed.
+	std::vector<std::vector<float>> uncached;
+	uncached.reserve(specs.size());
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		if (values[i]) continue;
+		const OctaveSpec& spec = specs[i];
+		std::vector<float> layer(m_width * m_height);
+		if (!noiseLayer(layer.data(), m_width, m_height, spec.grid_cell_size, spec.seed, source, noise, pool, progress, cancel)) return false;
+		if (m_max_layers > 0 && evict(stamp, m_max_layers - 1)) {
+			m_layers.push_back({ spec.seed, spec.grid_cell_size, source, noise, std::move(layer), stamp });
+			values[i] = m_layers.back().values.data();
+		}
+		else {
+			uncached.push_back(std::move(layer));
+			values[i] = uncached.back().data();
+		}
+	}
+
+	// Same summation order as the fused generateMap, so the result is
+	// bit-identical.
+	pool.parallelFor(bands, [&](size_t band) {
+		if (cancel && cancel->cancelled()) return;
+		size_t begin = band * TILE_SIZE * m_width;
+		size_t end = std::min(m_height, (band + 1) * TILE_SIZE) * m_width;
+		std::fill(map + begin, map + end, 0.f);
+		for (size_t i = 0; i < specs.size(); i++)
+		{
+			const float* layer = values[i];
+			float amplitude = specs[i].amplitude;
+			for (size_t j = begin; j < end; j++)
+			{
+				map[j] += layer[j] * amplitude;
+			}
+		}
+		if (progress) progress->done++;
+		});
+	return !(cancel && cancel->cancelled());
+}
+
+bool OctaveCache::evict(size_t keep_since, size_t limit) {
+	while (m_layers.size() > limit) {
+		auto oldest = std::min_element(m_layers.begin(), m_layers.end(), [](const Layer& a, const Layer& b) {
+			return a.last_used < b.last_used;
+			});
+		if (oldest->last_used >= keep_since) return false;
+		m_layers.erase(oldest);
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "generator.h"
+
+#include <vector>
+
+// Layers kept by default, about 3.5 MB each for a 1280x720 map.
+const size_t DEFAULT_CACHED_LAYERS = 32;
+
+// Generates maps of one size from cached per-octave noise layers. A layer
+// is identified by its seed, cell size, gradient source and backend, so changing
+// the persistence only re-sums the layers, changing the lacunarity only
+// computes the octaves whose cell size moved, and adding an octave only
+// computes the new one. Maps are identical to generateMap.
+class OctaveCache {
+public:
+	OctaveCache(size_t width, size_t height, size_t max_layers = DEFAULT_CACHED_LAYERS);
+
+	// Octaves of these parameters not cached yet.
+	size_t missingLayers(size_t octaves, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise) const;
+
+	// Tiles generate advances progress by for these parameters.
+	size_t progressTiles(size_t octaves, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise) const;
+
+	// Computes the missing layers and sums all of them into map. progress is
+	// advanced by progressTiles but not reset, so the caller can count work
+	// before it too. Layers finished before a cancel stay cached. The cache
+	// never holds more than max_layers: a new layer replaces the least
+	// recently used one not needed here, and if all of them are needed it is
+	// not cached, so maps with more octaves than that recompute the rest
+	// every time. Returns false if cancelled.
+	bool generate(float* map, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+private:
+	struct Layer {
+		uint32_t seed;
+		size_t grid_cell_size;
+		GradientSource source;
+		NoiseBackend noise;
+		std::vector<float> values;
+		size_t last_used;
+	};
+
+	// Index of the layer or m_layers.size() if it isn't cached.
+	size_t find(const OctaveSpec& spec, GradientSource source, NoiseBackend noise) const;
+	// Drops the least recently used layers until at most limit are left,
+	// but none used since keep_since. Returns false if that isn't enough.
+	bool evict(size_t keep_since, size_t limit);
+
+	size_t m_width;
+	size_t m_height;
+	size_t m_max_layers;
+	std::vector<Layer> m_layers;
+	size_t m_clock = 0;
+};
@@ -0,0 +1,23 @@
+#include "parse_args.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+bool parseSize(const char* text, size_t& value) {
+	// strtoull skips leading whitespace and negates after a '-', so " -5"
+	// would wrap around instead of failing.
+	if (strchr(text, '-')) return false;
+	char* end;
+	errno = 0;
+	unsigned long long parsed = strtoull(text, &end, 10);
+	if (*end != '\0' || end == text || errno == ERANGE) return false;
+	value = (size_t)parsed;
+	return true;
+}
+
+bool parseFloat(const char* text, float& value) {
+	char* end;
+	value = strtof(text, &end);
+	return *end == '\0' && end != text;
+}
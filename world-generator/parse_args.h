@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+// Command-line value parsers shared by worldgen-cli and worldgen-bench.
+// Each returns false, leaving value unspecified, unless all of text parses.
+
+// Non-negative decimal integer that fits in an unsigned long long.
+bool parseSize(const char* text, size_t& value);
+
+bool parseFloat(const char* text, float& value);
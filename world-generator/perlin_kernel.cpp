@@ -0,0 +1,163 @@
+#include "perlin_kernel.h"
+#include "simd.h"
+
+// All kernels keep the operation order of the scalar one, so they produce
+// the same values as long as the compiler doesn't contract into FMA.
+
+float perlin_smoothstep(float x) {
+	return (6 * x * x * x * x * x - 15 * x * x * x * x + 10 * x * x * x);
+	//return (3.0 - x * 2.0) * x * x;
+	//return x;
+	//return ((x * (x * 6.0 - 15.0) + 10.0) * x * x * x);
+}
+
+static void perlin_span_scalar(float* out, size_t n, size_t lx0, size_t step, float size, float fy, float sy, const float* g) {
+	for (size_t k = 0; k < n; k++)
+	{
+		float fx = (float)(lx0 + k * step) / size;
+
+		float top_left_dp	  = fx * g[0] + fy * g[1];
+		float top_right_dp	  = (fx - 1.f) * g[2] + fy * g[3];
+		float bottom_left_dp  = fx * g[4] + (fy - 1.f) * g[5];
+		float bottom_right_dp = (fx - 1.f) * g[6] + (fy - 1.f) * g[7];
+
+		float sx = perlin_smoothstep(fx);
+		float n0 = top_left_dp + sx * (top_right_dp - top_left_dp);
+		float n1 = bottom_left_dp + sx * (bottom_right_dp - bottom_left_dp);
+		out[k] = n0 + sy * (n1 - n0);
+	}
+}
+
+#ifdef WG_X86
+
+static void perlin_span_sse(float* out, size_t n, size_t lx0, size_t step, float size, float fy, float sy, const float* g) {
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 c6 = _mm_set1_ps(6.f);
+	const __m128 c15 = _mm_set1_ps(15.f);
+	const __m128 c10 = _mm_set1_ps(10.f);
+	// Columns are whole numbers below 2^24, so lx0 + lane * step is exact
+	// and fx matches the scalar kernel for every step.
+	const __m128 lanes = _mm_mul_ps(_mm_setr_ps(0.f, 1.f, 2.f, 3.f), _mm_set1_ps((float)step));
+	const __m128 v_size = _mm_set1_ps(size);
+	const __m128 v_sy = _mm_set1_ps(sy);
+
+	// The y halves of the dot products are constant along the span.
+	const __m128 top_left_y = _mm_set1_ps(fy * g[1]);
+	const __m128 top_right_y = _mm_set1_ps(fy * g[3]);
+	const __m128 bottom_left_y = _mm_set1_ps((fy - 1.f) * g[5]);
+	const __m128 bottom_right_y = _mm_set1_ps((fy - 1.f) * g[7]);
+	const __m128 g00x = _mm_set1_ps(g[0]);
+	const __m128 g10x = _mm_set1_ps(g[2]);
+	const __m128 g01x = _mm_set1_ps(g[4]);
+	const __m128 g11x = _mm_set1_ps(g[6]);
+
+	size_t k = 0;
+	for (; k + 4 <= n; k += 4)
+	{
+		__m128 fx = _mm_div_ps(_mm_add_ps(_mm_set1_ps((float)(lx0 + k * step)), lanes), v_size);
+		__m128 fx1 = _mm_sub_ps(fx, one);
+
+		__m128 top_left_dp = _mm_add_ps(_mm_mul_ps(fx, g00x), top_left_y);
+		__m128 top_right_dp = _mm_add_ps(_mm_mul_ps(fx1, g10x), top_right_y);
+		__m128 bottom_left_dp = _mm_add_ps(_mm_mul_ps(fx, g01x), bottom_left_y);
+		__m128 bottom_right_dp = _mm_add_ps(_mm_mul_ps(fx1, g11x), bottom_right_y);
+
+		__m128 term3 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c10, fx), fx), fx);
+		__m128 term4 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c15, fx), fx), fx), fx);
+		__m128 term5 = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c6, fx), fx), fx), fx), fx);
+		__m128 sx = _mm_add_ps(_mm_sub_ps(term5, term4), term3);
+
+		__m128 n0 = _mm_add_ps(top_left_dp, _mm_mul_ps(sx, _mm_sub_ps(top_right_dp, top_left_dp)));
+		__m128 n1 = _mm_add_ps(bottom_left_dp, _mm_mul_ps(sx, _mm_sub_ps(bottom_right_dp, bottom_left_dp)));
+		_mm_storeu_ps(out + k, _mm_add_ps(n0, _mm_mul_ps(v_sy, _mm_sub_ps(n1, n0))));
+	}
+	perlin_span_scalar(out + k, n - k, lx0 + k * step, step, size, fy, sy, g);
+}
+
+WG_TARGET_AVX2
+static void perlin_span_avx2(float* out, size_t n, size_t lx0, size_t step, float size, float fy, float sy, const float* g) {
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 c6 = _mm256_set1_ps(6.f);
+	const __m256 c15 = _mm256_set1_ps(15.f);
+	const __m256 c10 = _mm256_set1_ps(10.f);
+	const __m256 lanes = _mm256_mul_ps(_mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f), _mm256_set1_ps((float)step));
+	const __m256 v_size = _mm256_set1_ps(size);
+	const __m256 v_sy = _mm256_set1_ps(sy);
+
+	const __m256 top_left_y = _mm256_set1_ps(fy * g[1]);
+	const __m256 top_right_y = _mm256_set1_ps(fy * g[3]);
+	const __m256 bottom_left_y = _mm256_set1_ps((fy - 1.f) * g[5]);
+	const __m256 bottom_right_y = _mm256_set1_ps((fy - 1.f) * g[7]);
+	const __m256 g00x = _mm256_set1_ps(g[0]);
+	const __m256 g10x = _mm256_set1_ps(g[2]);
+	const __m256 g01x = _mm256_set1_ps(g[4]);
+	const __m256 g11x = _mm256_set1_ps(g[6]);
+
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8)
+	{
+		__m256 fx = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps((float)(lx0 + k * step)), lanes), v_size);
+		__m256 fx1 = _mm256_sub_ps(fx, one);
+
+		__m256 top_left_dp = _mm256_add_ps(_mm256_mul_ps(fx, g00x), top_left_y);
+		__m256 top_right_dp = _mm256_add_ps(_mm256_mul_ps(fx1, g10x), top_right_y);
+		__m256 bottom_left_dp = _mm256_add_ps(_mm256_mul_ps(fx, g01x), bottom_left_y);
+		__m256 bottom_right_dp = _mm256_add_ps(_mm256_mul_ps(fx1, g11x), bottom_right_y);
+
+		__m256 term3 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(c10, fx), fx), fx);
+		__m256 term4 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(c15, fx), fx), fx), fx);
+		__m256 term5 = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(c6, fx), fx), fx), fx), fx);
+		__m256 sx = _mm256_add_ps(_mm256_sub_ps(term5, term4), term3);
+
+		__m256 n0 = _mm256_add_ps(top_left_dp, _mm256_mul_ps(sx, _mm256_sub_ps(top_right_dp, top_left_dp)));
+		__m256 n1 = _mm256_add_ps(bottom_left_dp, _mm256_mul_ps(sx, _mm256_sub_ps(bottom_right_dp, bottom_left_dp)));
+		_mm256_storeu_ps(out + k, _mm256_add_ps(n0, _mm256_mul_ps(v_sy, _mm256_sub_ps(n1, n0))));
+	}
+	// Leftovers of up to 7 pixels still get 4 wide.
+	perlin_span_sse(out + k, n - k, lx0 + k * step, step, size, fy, sy, g);
+}
+
+// The AVX2 level includes F16C, which every AVX2 CPU has in practice.
+static bool cpuHasAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool f16c = (info[2] & (1 << 29)) != 0;
+	if (!osxsave || !avx || !f16c || (_xgetbv(0) & 0x6) != 0x6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+}
+
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef WG_X86
+	static const SimdLevel level = cpuHasAvx2() ? SimdLevel::AVX2 : SimdLevel::SSE;
+	return level;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::AVX2: return "AVX2";
+	case SimdLevel::SSE: return "SSE";
+	default: return "scalar";
+	}
+}
+
+PerlinSpanKernel perlinSpanKernel(SimdLevel level) {
+#ifdef WG_X86
+	if (level == SimdLevel::AVX2) return perlin_span_avx2;
+	if (level == SimdLevel::SSE) return perlin_span_sse;
+#endif
+	return perlin_span_scalar;
+}
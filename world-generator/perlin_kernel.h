@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+enum class SimdLevel { Scalar, SSE, AVX2 };
+
+// Widest instruction set both compiled in and supported by this CPU.
+SimdLevel detectSimdLevel();
+
+const char* simdLevelName(SimdLevel level);
+
+// Evaluates n pixels of one row, step columns apart, that all fall into the
+// same Perlin cell. lx0 is the column of the first pixel inside the cell, fy
+// the row's offset in the cell in [0, 1) and sy = perlin_smoothstep(fy). g
+// holds the cell's corner gradients as x, y pairs: top-left, top-right,
+// bottom-left, bottom-right. A pixel gets the same value for any step.
+typedef void (*PerlinSpanKernel)(float* out, size_t n, size_t lx0, size_t step, float size, float fy, float sy, const float* g);
+
+PerlinSpanKernel perlinSpanKernel(SimdLevel level);
+
+float perlin_smoothstep(float x);
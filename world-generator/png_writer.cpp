@@ -0,0 +1,212 @@
+#include "png_writer.h"
+
+#include <algorithm>
+
+#ifdef WG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Compressed bytes collected before they are written as one IDAT chunk.
+const size_t IDAT_SIZE = 1 << 18;
+// Largest payload of a stored deflate block.
+const size_t STORED_BLOCK_SIZE = 65535;
+
+const uint32_t* crcTable() {
+	static const std::vector<uint32_t> table = []() {
+		std::vector<uint32_t> t(256);
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			t[n] = c;
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+	const uint32_t* table = crcTable();
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+void putBigEndian(uint8_t* out, uint32_t value) {
+	out[0] = (uint8_t)(value >> 24);
+	out[1] = (uint8_t)(value >> 16);
+	out[2] = (uint8_t)(value >> 8);
+	out[3] = (uint8_t)value;
+}
+
+}
+
+// Turns the filtered rows into the zlib stream of the IDAT chunks and hands
+// it to PngWriter::emit.
+struct PngWriter::Deflater {
+	bool ok = true;
+
+	virtual ~Deflater() = default;
+	virtual bool write(PngWriter& png, const uint8_t* data, size_t size, bool last) = 0;
+
+protected:
+	static void emit(PngWriter& png, const uint8_t* data, size_t size) { png.emit(data, size); }
+};
+
+namespace {
+
+// Wraps data in a zlib stream of stored blocks by hand.
+struct StoredDeflater : PngWriter::Deflater {
+	std::vector<uint8_t> block;
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	bool started = false;
+
+	bool write(PngWriter& png, const uint8_t* data, size_t size, bool last) override {
+		if (!started) {
+			const uint8_t header[2] = { 0x78, 0x01 };
+			emit(png, header, 2);
+			started = true;
+		}
+		for (size_t i = 0; i < size; i++)
+		{
+			adler_a = (adler_a + data[i]) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+		while (size > 0) {
+			size_t n = std::min(size, STORED_BLOCK_SIZE - block.size());
+			block.insert(block.end(), data, data + n);
+			data += n;
+			size -= n;
+			if (block.size() == STORED_BLOCK_SIZE) flush(png, false);
+		}
+		if (last) {
+			flush(png, true);
+			uint8_t adler[4];
+			putBigEndian(adler, (adler_b << 16) | adler_a);
+			emit(png, adler, 4);
+		}
+		return true;
+	}
+
+	void flush(PngWriter& png, bool final_block) {
+		uint16_t len = (uint16_t)block.size();
+		const uint8_t header[5] = { (uint8_t)(final_block ? 1 : 0), (uint8_t)(len & 0xFF), (uint8_t)(len >> 8), (uint8_t)(~len & 0xFF), (uint8_t)((uint16_t)~len >> 8) };
+		emit(png, header, 5);
+		emit(png, block.data(), block.size());
+		block.clear();
+	}
+};
+
+#ifdef WG_HAVE_ZLIB
+
+struct ZlibDeflater : PngWriter::Deflater {
+	z_stream stream{};
+
+	// The fastest level, since export time is dominated by deflate.
+	ZlibDeflater() { ok = deflateInit(&stream, Z_BEST_SPEED) == Z_OK; }
+	~ZlibDeflater() override { deflateEnd(&stream); }
+
+	bool write(PngWriter& png, const uint8_t* data, size_t size, bool last) override {
+		uint8_t out[1 << 14];
+		stream.next_in = const_cast<uint8_t*>(data);
+		stream.avail_in = (uInt)size;
+		int result;
+		do {
+			stream.next_out = out;
+			stream.avail_out = sizeof(out);
+			result = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+			if (result == Z_STREAM_ERROR) return false;
+			emit(png, out, sizeof(out) - stream.avail_out);
+		} while (stream.avail_out == 0 || (last && result != Z_STREAM_END));
+		return true;
+	}
+};
+
+#endif
+
+std::unique_ptr<PngWriter::Deflater> makeDeflater(bool compress) {
+#ifdef WG_HAVE_ZLIB
+	if (compress) return std::make_unique<ZlibDeflater>();
+#endif
+	return std::make_unique<StoredDeflater>();
+}
+
+}
+
+PngWriter::PngWriter(FILE* file, size_t width, size_t height, Format format, bool compress)
+	: m_file(file), m_height(height), m_deflater(makeDeflater(compress)) {
+	m_bytes_per_pixel = format == Format::Gray16 ? 2 : 4;
+	m_row_bytes = width * m_bytes_per_pixel;
+	m_filtered.resize(m_row_bytes + 1);
+	m_ok = m_deflater->ok;
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	m_ok = m_ok && fwrite(signature, 1, 8, m_file) == 8;
+	uint8_t header[13];
+	putBigEndian(header, (uint32_t)width);
+	putBigEndian(header + 4, (uint32_t)height);
+	header[8] = format == Format::Gray16 ? 16 : 8;
+	header[9] = format == Format::Gray16 ? 0 : 6;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	writeChunk("IHDR", header, sizeof(header));
+}
+
+PngWriter::~PngWriter() = default;
+
+bool PngWriter::writeRows(const uint8_t* rows, size_t count) {
+	if (count > m_height - m_rows_written) m_ok = false;
+	for (size_t i = 0; i < count && m_ok; i++)
+	{
+		filterRow(rows + i * m_row_bytes);
+		m_ok = m_deflater->write(*this, m_filtered.data(), m_filtered.size(), false);
+		m_rows_written++;
+	}
+	return m_ok;
+}
+
+bool PngWriter::finish() {
+	m_ok = m_ok && m_deflater->write(*this, nullptr, 0, true);
+	if (!m_idat.empty()) writeChunk("IDAT", m_idat.data(), m_idat.size());
+	writeChunk("IEND", nullptr, 0);
+	return m_ok && m_rows_written == m_height;
+}
+
+void PngWriter::filterRow(const uint8_t* row) {
+	// The Sub filter stores each byte minus the same byte of the pixel to
+	// its left, which suits smooth heightmaps and costs no extra state.
+	m_filtered[0] = 1;
+	for (size_t i = 0; i < m_row_bytes; i++)
+	{
+		uint8_t left = i >= m_bytes_per_pixel ? row[i - m_bytes_per_pixel] : 0;
+		m_filtered[i + 1] = (uint8_t)(row[i] - left);
+	}
+}
+
+void PngWriter::emit(const uint8_t* data, size_t size) {
+	m_idat.insert(m_idat.end(), data, data + size);
+	if (m_idat.size() >= IDAT_SIZE) {
+		writeChunk("IDAT", m_idat.data(), m_idat.size());
+		m_idat.clear();
+	}
+}
+
+void PngWriter::writeChunk(const char* type, const uint8_t* data, size_t size) {
+	uint8_t length[4];
+	putBigEndian(length, (uint32_t)size);
+	uint32_t crc = updateCrc(0xFFFFFFFFu, (const uint8_t*)type, 4);
+	if (size > 0) crc = updateCrc(crc, data, size);
+	uint8_t crc_bytes[4];
+	putBigEndian(crc_bytes, crc ^ 0xFFFFFFFFu);
+	m_ok = m_ok && fwrite(length, 1, 4, m_file) == 4 && fwrite(type, 1, 4, m_file) == 4
+		&& (size == 0 || fwrite(data, 1, size, m_file) == size) && fwrite(crc_bytes, 1, 4, m_file) == 4;
+}
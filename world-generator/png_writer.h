@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Streams a PNG image to a file a few rows at a time, so memory use doesn't
+// depend on the image size. Image data is deflated with zlib when the build
+// has it (WG_HAVE_ZLIB) and written as stored, uncompressed deflate blocks
+// otherwise or when compression is turned off. Either way the file is a
+// valid PNG.
+class PngWriter {
+public:
+	enum class Format {
+		// 16-bit grayscale, samples big-endian.
+		Gray16,
+		// 8-bit RGBA.
+		Rgba8,
+	};
+
+	// Writes the signature and header to file, which stays owned by the
+	// caller. compress = false writes stored blocks even with zlib.
+	PngWriter(FILE* file, size_t width, size_t height, Format format, bool compress = true);
+	~PngWriter();
+
+	PngWriter(const PngWriter&) = delete;
+	PngWriter& operator=(const PngWriter&) = delete;
+
+	// Appends count rows of samples in the layout of the format. Rows past
+	// the height are refused and fail the image.
+	bool writeRows(const uint8_t* rows, size_t count);
+
+	// Writes the rest of the image data and the end of the file. Call once
+	// after all height rows. Returns false if any write failed or fewer rows
+	// were written.
+	bool finish();
+
+	// Zlib or stored-block stream of the image data, see png_writer.cpp.
+	struct Deflater;
+
+private:
+	void filterRow(const uint8_t* row);
+	void emit(const uint8_t* data, size_t size);
+	void writeChunk(const char* type, const uint8_t* data, size_t size);
+
+	FILE* m_file;
+	size_t m_height;
+	size_t m_rows_written = 0;
+	size_t m_row_bytes;
+	size_t m_bytes_per_pixel;
+	bool m_ok = true;
+	// The current row filtered, with its filter type byte in front.
+	std::vector<uint8_t> m_filtered;
+	// Compressed data waiting to be written as an IDAT chunk.
+	std::vector<uint8_t> m_idat;
+	std::unique_ptr<Deflater> m_deflater;
+};
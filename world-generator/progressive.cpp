@@ -0,0 +1,54 @@
+#include "progressive.h"
+
+#include <algorithm>
+#include <vector>
+
+bool generateMapProgressive(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, const LevelCallback& on_level, GenerationProgress* progress, const CancellationToken* cancel) {
+	// The gradients are built once and shared by all levels.
+	std::vector<Octave> layers;
+	if (!mapOctaves(layers, width, height, octaves, persistence, lacunarity, seed, source, noise, cancel)) return false;
+	if (progress) {
+		progress->done = 0;
+		progress->total = previewTiles(width, height) + sampleTiles(width, height, 1);
+	}
+
+	std::vector<float> coarse;
+	if (!generatePreviews(coarse, layers, width, height, pool, on_level, progress, cancel)) return false;
+	return sampleOctaves(map, width, height, 1, layers, pool, coarse.empty() ? nullptr : coarse.data(), progress, cancel);
+}
+
+size_t previewTiles(size_t width, size_t height) {
+	size_t tiles = 0;
+	for (size_t step = PREVIEW_STEP; step > 1; step /= 2)
+	{
+		tiles += sampleTiles(width, height, step);
+	}
+	return tiles;
+}
+
+bool generatePreviews(std::vector<float>& finest, const std::vector<Octave>& layers, size_t width, size_t height, ThreadPool& pool, const LevelCallback& on_level, GenerationProgress* progress, const CancellationToken* cancel) {
+	finest.clear();
+	std::vector<float> level;
+	for (size_t step = PREVIEW_STEP; step > 1; step /= 2)
+	{
+		level.resize(sampleCount(width, step) * sampleCount(height, step));
+		const float* reuse = finest.empty() ? nullptr : finest.data();
+		if (!sampleOctaves(level.data(), width, height, step, layers, pool, reuse, progress, cancel)) return false;
+		on_level(level.data(), step);
+		finest.swap(level);
+	}
+	return true;
+}
+
+void expandLevel(const float* level, size_t step, float* map, size_t width, size_t height) {
+	size_t level_w = sampleCount(width, step);
+	for (size_t y = 0; y < height; y++)
+	{
+		const float* level_row = level + (y / step) * level_w;
+		float* row = map + y * width;
+		for (size_t x = 0; x < width; x++)
+		{
+			row[x] = level_row[x / step];
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "generator.h"
+
+#include <functional>
+#include <vector>
+
+// Step of the first, coarsest level of generateMapProgressive. Every level
+// after it halves the step down to the full map at step 1.
+const size_t PREVIEW_STEP = 8;
+
+// Called with every level before the full map, sampled every step pixels
+// and sampleCount(width, step) wide.
+typedef std::function<void(const float* level, size_t step)> LevelCallback;
+
+// Same result as generateMap, but first samples the map every PREVIEW_STEP
+// pixels and refines from there, reusing every coarser level in the next.
+// on_level sees each level as soon as it is done. progress covers all
+// levels. Returns false if cancelled.
+bool generateMapProgressive(float* map, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, ThreadPool& pool, const LevelCallback& on_level, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// Tiles generatePreviews advances progress by.
+size_t previewTiles(size_t width, size_t height);
+
+// The levels of generateMapProgressive before the full map. Samples layers
+// every PREVIEW_STEP pixels, then at half the step down to step 2, and passes
+// each level to on_level. finest is left holding the step 2 level. progress
+// is advanced per tile, previewTiles in all, but not reset. Returns false if
+// cancelled.
+bool generatePreviews(std::vector<float>& finest, const std::vector<Octave>& layers, size_t width, size_t height, ThreadPool& pool, const LevelCallback& on_level, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
+
+// Fills a width x height map from a level sampled every step pixels by
+// repeating each sample over its step x step block.
+void expandLevel(const float* level, size_t step, float* map, size_t width, size_t height);
@@ -0,0 +1,16 @@
+#pragma once
+
+// Intrinsics for the SIMD kernels. WG_X86 is defined where the SSE and AVX2
+// kernels are compiled in. AVX2 code, which may also use F16C, is compiled
+// per function with WG_TARGET_AVX2, so only detectSimdLevel() decides
+// whether it runs.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WG_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WG_TARGET_AVX2
+#else
+#define WG_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+#endif
@@ -0,0 +1,253 @@
+#include "simplex.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Skews a point onto the simplex lattice and back.
+const double SKEW = 0.36602540378443865;   // (sqrt(3) - 1) / 2
+const double UNSKEW = 0.21132486540518713; // (3 - sqrt(3)) / 6
+const float UNSKEW_F = (float)UNSKEW;
+// Scales the sum of the corners to at most 0.7056 with unit gradients,
+// about the Perlin range; see SIMPLEX_BOUND.
+const float SIMPLEX_SCALE = 70.f;
+
+// std::floor is a libm call without SSE4.1.
+int64_t floorToInt(double v) {
+	int64_t i = (int64_t)v;
+	return v < i ? i - 1 : i;
+}
+
+// Column, in pixels, where the row at yin leaves skewed column cx to the
+// right. A pixel is in the skewed column whose end is the first one past
+// it, so its cell only depends on the pixel and not on where a run starts.
+double columnEnd(int64_t cx, double yin, size_t size) {
+	return (cx + 1 - yin * SKEW) / (1 + SKEW) * size;
+}
+
+// Column where the row at yin leaves skewed row cy, which it also crosses
+// from top to bottom going right.
+double rowEnd(int64_t cy, double yin, size_t size) {
+	return (cy + 1 - yin * (1 + SKEW)) / SKEW * size;
+}
+
+// Samples, at most remaining, from column x on, step apart, left of end.
+size_t samplesBefore(double end, int64_t x, size_t step, size_t remaining) {
+	double guess = std::ceil((end - x) / step);
+	size_t n = guess < 0 ? 0 : guess > remaining ? remaining : (size_t)guess;
+	while (n > 0 && x + (int64_t)((n - 1) * step) >= end) n--;
+	while (n < remaining && x + (int64_t)(n * step) < end) n++;
+	return n;
+}
+
+// Term of corner c for a pixel at x offset dx0 from the cell's origin.
+float cornerTerm(const float* corners, const float* base, const float* dot_y, size_t c, float dx0) {
+	float dx = dx0 - corners[c * 4 + 2];
+	float t = std::max(0.f, base[c] - dx * dx);
+	t *= t;
+	return t * t * (corners[c * 4] * dx + dot_y[c]);
+}
+
+void simplex_span_scalar(float* out, size_t n, int64_t lx0, size_t step, float size, float offset, const float* corners) {
+	// Parts of every corner's term that don't change along the span.
+	float base[4];
+	float dot_y[4];
+	for (size_t c = 0; c < 4; c++)
+	{
+		float dy = corners[c * 4 + 3];
+		base[c] = 0.5f - dy * dy;
+		dot_y[c] = corners[c * 4 + 1] * dy;
+	}
+	float dy0 = corners[3];
+	for (size_t k = 0; k < n; k++)
+	{
+		float dx0 = (float)(lx0 + (int64_t)(k * step)) / size + offset;
+		float sum = 0.f;
+		sum += cornerTerm(corners, base, dot_y, 0, dx0);
+		sum += cornerTerm(corners, base, dot_y, dx0 > dy0 ? 1 : 2, dx0);
+		sum += cornerTerm(corners, base, dot_y, 3, dx0);
+		out[k] = sum * SIMPLEX_SCALE;
+	}
+}
+
+#ifdef WG_X86
+
+// Same operations as the scalar kernel in the same order, four pixels wide.
+// Both middle corners are computed and each lane keeps its triangle's.
+void simplex_span_sse(float* out, size_t n, int64_t lx0, size_t step, float size, float offset, const float* corners) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lanes = _mm_mul_ps(_mm_setr_ps(0.f, 1.f, 2.f, 3.f), _mm_set1_ps((float)step));
+	const __m128 v_size = _mm_set1_ps(size);
+	const __m128 v_offset = _mm_set1_ps(offset);
+	const __m128 dy0 = _mm_set1_ps(corners[3]);
+	const __m128 scale = _mm_set1_ps(SIMPLEX_SCALE);
+	__m128 gx[4];
+	__m128 shift[4];
+	__m128 base[4];
+	__m128 dot_y[4];
+	for (size_t c = 0; c < 4; c++)
+	{
+		float dy = corners[c * 4 + 3];
+		gx[c] = _mm_set1_ps(corners[c * 4]);
+		shift[c] = _mm_set1_ps(corners[c * 4 + 2]);
+		base[c] = _mm_set1_ps(0.5f - dy * dy);
+		dot_y[c] = _mm_set1_ps(corners[c * 4 + 1] * dy);
+	}
+
+	// Runs are a cell wide at most, so the last partial vector is computed
+	// in full too and only its pixels inside the run are stored.
+	for (size_t k = 0; k < n; k += 4)
+	{
+		__m128 column = _mm_add_ps(_mm_set1_ps((float)(lx0 + (int64_t)(k * step))), lanes);
+		__m128 dx0 = _mm_add_ps(_mm_div_ps(column, v_size), v_offset);
+		__m128 term[4];
+		for (size_t c = 0; c < 4; c++)
+		{
+			__m128 dx = _mm_sub_ps(dx0, shift[c]);
+			__m128 t = _mm_max_ps(_mm_sub_ps(base[c], _mm_mul_ps(dx, dx)), zero);
+			t = _mm_mul_ps(t, t);
+			__m128 dot = _mm_add_ps(_mm_mul_ps(gx[c], dx), dot_y[c]);
+			term[c] = _mm_mul_ps(_mm_mul_ps(t, t), dot);
+		}
+		__m128 lower = _mm_cmpgt_ps(dx0, dy0);
+		__m128 middle = _mm_or_ps(_mm_and_ps(lower, term[1]), _mm_andnot_ps(lower, term[2]));
+		__m128 sum = _mm_add_ps(zero, term[0]);
+		sum = _mm_add_ps(sum, middle);
+		sum = _mm_add_ps(sum, term[3]);
+		sum = _mm_mul_ps(sum, scale);
+		if (k + 4 <= n) {
+			_mm_storeu_ps(out + k, sum);
+		}
+		else {
+			float last[4];
+			_mm_storeu_ps(last, sum);
+			std::copy(last, last + (n - k), out + k);
+		}
+	}
+}
+
+WG_TARGET_AVX2
+void simplex_span_avx2(float* out, size_t n, int64_t lx0, size_t step, float size, float offset, const float* corners) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 lanes = _mm256_mul_ps(_mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f), _mm256_set1_ps((float)step));
+	const __m256 v_size = _mm256_set1_ps(size);
+	const __m256 v_offset = _mm256_set1_ps(offset);
+	const __m256 dy0 = _mm256_set1_ps(corners[3]);
+	const __m256 scale = _mm256_set1_ps(SIMPLEX_SCALE);
+	__m256 gx[4];
+	__m256 shift[4];
+	__m256 base[4];
+	__m256 dot_y[4];
+	for (size_t c = 0; c < 4; c++)
+	{
+		float dy = corners[c * 4 + 3];
+		gx[c] = _mm256_set1_ps(corners[c * 4]);
+		shift[c] = _mm256_set1_ps(corners[c * 4 + 2]);
+		base[c] = _mm256_set1_ps(0.5f - dy * dy);
+		dot_y[c] = _mm256_set1_ps(corners[c * 4 + 1] * dy);
+	}
+
+	for (size_t k = 0; k < n; k += 8)
+	{
+		__m256 column = _mm256_add_ps(_mm256_set1_ps((float)(lx0 + (int64_t)(k * step))), lanes);
+		__m256 dx0 = _mm256_add_ps(_mm256_div_ps(column, v_size), v_offset);
+		__m256 term[4];
+		for (size_t c = 0; c < 4; c++)
+		{
+			__m256 dx = _mm256_sub_ps(dx0, shift[c]);
+			__m256 t = _mm256_max_ps(_mm256_sub_ps(base[c], _mm256_mul_ps(dx, dx)), zero);
+			t = _mm256_mul_ps(t, t);
+			__m256 dot = _mm256_add_ps(_mm256_mul_ps(gx[c], dx), dot_y[c]);
+			term[c] = _mm256_mul_ps(_mm256_mul_ps(t, t), dot);
+		}
+		__m256 middle = _mm256_blendv_ps(term[2], term[1], _mm256_cmp_ps(dx0, dy0, _CMP_GT_OQ));
+		__m256 sum = _mm256_add_ps(zero, term[0]);
+		sum = _mm256_add_ps(sum, middle);
+		sum = _mm256_add_ps(sum, term[3]);
+		sum = _mm256_mul_ps(sum, scale);
+		if (k + 8 <= n) {
+			_mm256_storeu_ps(out + k, sum);
+		}
+		else {
+			float last[8];
+			_mm256_storeu_ps(last, sum);
+			std::copy(last, last + (n - k), out + k);
+		}
+	}
+}
+
+#endif
+
+}
+
+size_t simplexLatticeSkew(size_t grid_w, size_t grid_h) {
+	return (size_t)((grid_w + grid_h) * SKEW) + 1;
+}
+
+SimplexSpanKernel simplexSpanKernel(SimdLevel level) {
+#ifdef WG_X86
+	if (level == SimdLevel::AVX2) return simplex_span_avx2;
+	if (level == SimdLevel::SSE) return simplex_span_sse;
+#endif
+	return simplex_span_scalar;
+}
+
+void simplex_process_rect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, SimplexSpanKernel kernel, size_t step) {
+	double scale = 1.0 / size;
+	for (size_t j = 0; j < height; j++)
+	{
+		double yin = (double)(y0 + (int64_t)(j * step)) * scale;
+		float* row = out + j * out_stride;
+
+		// Cell of the first pixel. Skewing gives it up to rounding, and the
+		// cell's ends settle pixels that lie on an edge.
+		double xin = x0 * scale;
+		double s = (xin + yin) * SKEW;
+		int64_t cx = floorToInt(xin + s);
+		int64_t cy = floorToInt(yin + s);
+		while (x0 >= columnEnd(cx, yin, size)) cx++;
+		while (x0 < columnEnd(cx - 1, yin, size)) cx--;
+		while (x0 >= rowEnd(cy, yin, size)) cy++;
+		while (x0 < rowEnd(cy - 1, yin, size)) cy--;
+		double column_end = columnEnd(cx, yin, size);
+		double row_end = rowEnd(cy, yin, size);
+
+		// Along a row both cell coordinates only grow, so every cell the
+		// row crosses is one run, with its gradients fetched once.
+		for (size_t i = 0; i < width;)
+		{
+			int64_t x = x0 + (int64_t)(i * step);
+			size_t n = samplesBefore(std::min(column_end, row_end), x, step, width - i);
+			if (n > 0) {
+				float g[8];
+				gradients.cellCorners(cx, cy, g);
+
+				// The corners are the cell's origin, top-right, bottom-left
+				// and far corner; the kernel picks one of the middle two per
+				// pixel. The anchor column only depends on the cell, so a
+				// pixel's offset doesn't depend on where its run starts.
+				double t = (cx + cy) * UNSKEW;
+				double origin_x = cx - t;
+				int64_t anchor = floorToInt(origin_x * size);
+				float offset = (float)(anchor * scale - origin_x);
+				float dy0 = (float)(yin - (cy - t));
+				float corners[16] = {
+					g[0], g[1], 0.f, dy0,
+					g[2], g[3], 1.f - UNSKEW_F, dy0 + UNSKEW_F,
+					g[4], g[5], -UNSKEW_F, dy0 - 1.f + UNSKEW_F,
+					g[6], g[7], 1.f - 2.f * UNSKEW_F, dy0 - 1.f + 2.f * UNSKEW_F,
+				};
+				kernel(row + i, n, x - anchor, step, (float)size, offset, corners);
+				i += n;
+			}
+			if (i == width) break;
+
+			int64_t next = x0 + (int64_t)(i * step);
+			while (next >= column_end) column_end = columnEnd(++cx, yin, size);
+			while (next >= row_end) row_end = rowEnd(++cy, yin, size);
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "gradients.h"
+#include "perlin_kernel.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// With unit gradients, simplex noise is largest where every corner's
+// gradient points along its offset, at 0.70562. The bound leaves room for
+// float rounding in the kernels.
+const float SIMPLEX_BOUND = 0.72f;
+
+// Lattice points simplex noise needs beyond a grid_w x grid_h square
+// lattice along each axis. The skewed lattice reaches further right and
+// down than the square one over the same map.
+size_t simplexLatticeSkew(size_t grid_w, size_t grid_h);
+
+// Evaluates n pixels of one row, step columns apart, that all fall into the
+// same cell of the simplex lattice. lx0 is the first pixel's column counted
+// from an anchor column of the cell, so a pixel's x offset from the cell's
+// origin is lx / size + offset in lattice units. corners holds four floats
+// for each of the cell's origin, top-right, bottom-left and far corner: the
+// gradient's x and y, the corner's x offset from the origin and the row's y
+// offset from the corner, which is the same for every pixel of the span.
+// Pixels right of the cell's diagonal sum the top-right corner and the rest
+// the bottom-left one. A pixel gets the same value for any step and any
+// first pixel of the span.
+typedef void (*SimplexSpanKernel)(float* out, size_t n, int64_t lx0, size_t step, float size, float offset, const float* corners);
+
+SimplexSpanKernel simplexSpanKernel(SimdLevel level);
+
+// 2D simplex noise over the same rect perlin_process_rect fills, with the
+// lattice scaled so one unskewed cell is size pixels. Every sample sums
+// three corners of its triangle instead of the four of a Perlin cell, and
+// the triangles have no axis-aligned edges to show through. Rows are split
+// into runs of pixels in the same skewed cell, which is located once per
+// run, and kernel evaluates each run. Values stay within SIMPLEX_BOUND.
+void simplex_process_rect(float* out, size_t out_stride, const GradientField& gradients, size_t size, int64_t x0, int64_t y0, size_t width, size_t height, SimplexSpanKernel kernel, size_t step = 1);
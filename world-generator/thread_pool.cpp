@@ -0,0 +1,146 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace {
+
+// Indices [begin, end) still owned by one participant of a parallelFor.
+struct Range {
+	std::mutex mutex;
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+// Moves the back half of the largest remaining range into ranges[thief].
+// Returns false once every range is empty.
+bool steal(std::vector<Range>& ranges, size_t thief) {
+	while (true) {
+		size_t victim = ranges.size();
+		size_t largest = 0;
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			if (i == thief) continue;
+			std::lock_guard<std::mutex> lock(ranges[i].mutex);
+			if (ranges[i].end - ranges[i].begin > largest) {
+				largest = ranges[i].end - ranges[i].begin;
+				victim = i;
+			}
+		}
+		if (victim == ranges.size()) return false;
+
+		size_t begin, end;
+		{
+			std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+			Range& r = ranges[victim];
+			if (r.begin == r.end) continue;
+			begin = r.begin + (r.end - r.begin) / 2;
+			end = r.end;
+			r.end = begin;
+		}
+		std::lock_guard<std::mutex> lock(ranges[thief].mutex);
+		ranges[thief].begin = begin;
+		ranges[thief].end = end;
+		return true;
+	}
+}
+
+}
+
+ThreadPool::ThreadPool(size_t threads_n) {
+	threads_n = std::max<size_t>(1, threads_n);
+	m_workers.reserve(threads_n);
+	for (size_t i = 0; i < threads_n; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	std::for_each(m_workers.begin(), m_workers.end(), std::mem_fn(&std::thread::join));
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push(std::move(job));
+	}
+	m_cv.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+	if (n == 0) return;
+
+	// Every participant starts with an equal contiguous range of indices and
+	// works through it front to back. Once its own range is empty it steals
+	// from the others, so slow tiles or workers that start late don't leave
+	// the rest idle.
+	struct Batch {
+		explicit Batch(size_t slots_n) : ranges(slots_n) {}
+		std::vector<Range> ranges;
+		std::atomic<size_t> next_slot{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable cv;
+	};
+
+	size_t slots_n = std::min(n, m_workers.size() + 1);
+	// Helpers may be picked up after the batch is finished, so the shared
+	// state outlives this call. fn is only touched while indices remain.
+	auto batch = std::make_shared<Batch>(slots_n);
+	for (size_t i = 0; i < slots_n; i++)
+	{
+		batch->ranges[i].begin = n * i / slots_n;
+		batch->ranges[i].end = n * (i + 1) / slots_n;
+	}
+
+	auto run = [batch, n, &fn]() {
+		size_t slot = batch->next_slot.fetch_add(1);
+		if (slot >= batch->ranges.size()) return;
+		Range& own = batch->ranges[slot];
+		while (true) {
+			size_t i = n;
+			{
+				std::lock_guard<std::mutex> lock(own.mutex);
+				if (own.begin < own.end) i = own.begin++;
+			}
+			if (i == n && !steal(batch->ranges, slot)) return;
+			if (i == n) continue;
+
+			fn(i);
+			if (batch->done.fetch_add(1) + 1 == n) {
+				std::lock_guard<std::mutex> lock(batch->mutex);
+				batch->cv.notify_all();
+			}
+		}
+	};
+
+	for (size_t i = 1; i < slots_n; i++)
+	{
+		submit(run);
+	}
+	run();
+
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	batch->cv.wait(lock, [&batch, n]() { return batch->done.load() == n; });
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop && m_jobs.empty()) return;
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+		}
+		job();
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Long-lived set of worker threads. Created once and reused for every
+// generation so no threads are spawned on the interactive path.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threads_n = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// Calls fn(i) for every i in [0, n), balancing the indices between workers
+	// by work stealing. The calling thread takes part in the work and the call
+	// returns once all n calls have finished.
+	void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+	size_t size() const { return m_workers.size(); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+};
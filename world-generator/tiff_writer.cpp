@@ -0,0 +1,432 @@
+#include "tiff_writer.h"
+#include "byte_order.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#ifdef WG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Writes the rect (x0, y0, width, height) of the full-resolution map to
+// out, rows stride floats apart. Called from several workers at once.
+typedef std::function<void(float* out, size_t stride, size_t x0, size_t y0, size_t width, size_t height)> FillRect;
+
+enum TiffType : uint16_t {
+	TYPE_SHORT = 3,
+	TYPE_LONG = 4,
+	TYPE_DOUBLE = 12,
+	TYPE_LONG8 = 16,
+};
+
+enum TiffTag : uint16_t {
+	TAG_NEW_SUBFILE_TYPE = 254,
+	TAG_IMAGE_WIDTH = 256,
+	TAG_IMAGE_LENGTH = 257,
+	TAG_BITS_PER_SAMPLE = 258,
+	TAG_COMPRESSION = 259,
+	TAG_PHOTOMETRIC = 262,
+	TAG_SAMPLES_PER_PIXEL = 277,
+	TAG_PLANAR_CONFIGURATION = 284,
+	TAG_PREDICTOR = 317,
+	TAG_TILE_WIDTH = 322,
+	TAG_TILE_LENGTH = 323,
+	TAG_TILE_OFFSETS = 324,
+	TAG_TILE_BYTE_COUNTS = 325,
+	TAG_SAMPLE_FORMAT = 339,
+	TAG_MODEL_PIXEL_SCALE = 33550,
+	TAG_MODEL_TIEPOINT = 33922,
+	TAG_GEO_KEY_DIRECTORY = 34735,
+};
+
+const uint16_t COMPRESSION_NONE = 1;
+const uint16_t COMPRESSION_DEFLATE = 8;
+const uint16_t SAMPLE_FORMAT_FLOAT = 3;
+const uint16_t PREDICTOR_FLOAT = 3;
+// NewSubfileType of a reduced-resolution copy of the first image.
+const uint32_t SUBFILE_REDUCED = 1;
+
+struct TileRef {
+	uint64_t offset;
+	uint64_t size;
+};
+
+// One resolution of the pyramid and the band of it being assembled.
+struct Level {
+	size_t width;
+	size_t height;
+	size_t tiles_w;
+	size_t tiles_h;
+	std::vector<TileRef> tiles;
+	// Rows band_y to band_y + band_rows of the level, at most a tile high.
+	std::vector<float> band;
+	size_t band_y = 0;
+	size_t band_rows = 0;
+};
+
+struct IfdEntry {
+	uint16_t tag;
+	uint16_t type;
+	uint64_t count;
+	std::vector<uint8_t> data;
+};
+
+template <typename T>
+IfdEntry ifdEntry(uint16_t tag, uint16_t type, const std::vector<T>& values) {
+	IfdEntry entry{ tag, type, values.size(), std::vector<uint8_t>(values.size() * sizeof(T)) };
+	copyRaw(entry.data.data(), values.data(), values.size());
+	return entry;
+}
+
+IfdEntry shortEntry(uint16_t tag, uint16_t value) {
+	return ifdEntry(tag, TYPE_SHORT, std::vector<uint16_t>{ value });
+}
+
+IfdEntry longEntry(uint16_t tag, uint32_t value) {
+	return ifdEntry(tag, TYPE_LONG, std::vector<uint32_t>{ value });
+}
+
+// Offsets and sizes are LONG in classic TIFF and LONG8 in BigTIFF.
+IfdEntry offsetEntry(uint16_t tag, const std::vector<uint64_t>& values, bool big) {
+	if (big) return ifdEntry(tag, TYPE_LONG8, values);
+	return ifdEntry(tag, TYPE_LONG, std::vector<uint32_t>(values.begin(), values.end()));
+}
+
+// Appends to a TIFF file from any thread.
+class TiffFile {
+public:
+	TiffFile(FILE* file, bool big) : m_file(file), m_big(big) {
+		uint8_t header[16] = { 'I', 'I' };
+		header[2] = big ? 43 : 42;
+		// BigTIFF: offset size 8, then a reserved zero.
+		if (big) header[4] = 8;
+		append(header, big ? 16 : 8);
+	}
+
+	bool ok() const { return m_ok; }
+
+	// Makes ok() false, e.g. when a tile couldn't be encoded.
+	void fail() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ok = false;
+	}
+
+	// Returns where data starts in the file.
+	uint64_t append(const void* data, size_t size) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t offset = m_end;
+		if (size == 0) return offset;
+		m_ok = m_ok && fwrite(data, 1, size, m_file) == size;
+		m_end += size;
+		return offset;
+	}
+
+	// Writes the directories of levels after all tiles and points the
+	// header at the first.
+	void writeDirectories(const std::vector<Level>& levels, size_t tile_size, bool deflate) {
+		// Directories and their values start on word boundaries.
+		uint8_t zero[1] = { 0 };
+		if (m_end % 2) append(zero, 1);
+		uint64_t first = m_end;
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			writeDirectory(directory(levels[i], i, tile_size, deflate), i + 1 == levels.size());
+		}
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ok = m_ok && fflush(m_file) == 0 && fseek(m_file, m_big ? 8 : 4, SEEK_SET) == 0;
+		uint8_t offset[8];
+		storeLittleEndian(offset, first, m_big ? 8 : 4);
+		m_ok = m_ok && fwrite(offset, 1, m_big ? 8 : 4, m_file) == (m_big ? 8u : 4u);
+	}
+
+private:
+	std::vector<IfdEntry> directory(const Level& level, size_t index, size_t tile_size, bool deflate) const {
+		std::vector<uint64_t> offsets;
+		std::vector<uint64_t> sizes;
+		for (const TileRef& tile : level.tiles) {
+			offsets.push_back(tile.offset);
+			sizes.push_back(tile.size);
+		}
+		// Sorted by tag, as TIFF requires.
+		std::vector<IfdEntry> entries = {
+			longEntry(TAG_NEW_SUBFILE_TYPE, index == 0 ? 0 : SUBFILE_REDUCED),
+			longEntry(TAG_IMAGE_WIDTH, (uint32_t)level.width),
+			longEntry(TAG_IMAGE_LENGTH, (uint32_t)level.height),
+			shortEntry(TAG_BITS_PER_SAMPLE, 32),
+			shortEntry(TAG_COMPRESSION, deflate ? COMPRESSION_DEFLATE : COMPRESSION_NONE),
+			// BlackIsZero.
+			shortEntry(TAG_PHOTOMETRIC, 1),
+			shortEntry(TAG_SAMPLES_PER_PIXEL, 1),
+			shortEntry(TAG_PLANAR_CONFIGURATION, 1),
+			shortEntry(TAG_PREDICTOR, deflate ? PREDICTOR_FLOAT : 1),
+			longEntry(TAG_TILE_WIDTH, (uint32_t)tile_size),
+			longEntry(TAG_TILE_LENGTH, (uint32_t)tile_size),
+			offsetEntry(TAG_TILE_OFFSETS, offsets, m_big),
+			offsetEntry(TAG_TILE_BYTE_COUNTS, sizes, m_big),
+			shortEntry(TAG_SAMPLE_FORMAT, SAMPLE_FORMAT_FLOAT),
+		};
+		if (index == 0) {
+			entries.push_back(ifdEntry(TAG_MODEL_PIXEL_SCALE, TYPE_DOUBLE, std::vector<double>{ 1, 1, 0 }));
+			entries.push_back(ifdEntry(TAG_MODEL_TIEPOINT, TYPE_DOUBLE, std::vector<double>{ 0, 0, 0, 0, 0, 0 }));
+			// Version 1.1.0 with two keys: a user-defined model type
+			// (GTModelTypeGeoKey) and pixels as areas (GTRasterTypeGeoKey).
+			entries.push_back(ifdEntry(TAG_GEO_KEY_DIRECTORY, TYPE_SHORT, std::vector<uint16_t>{
+				1, 1, 0, 2,
+				1024, 0, 1, 32767,
+				1025, 0, 1, 1,
+			}));
+		}
+		return entries;
+	}
+
+	// Writes one directory at the end of the file with the values too
+	// large for their entry right after it, followed by the next
+	// directory unless last.
+	void writeDirectory(const std::vector<IfdEntry>& entries, bool last) {
+		// Counts, offsets and inline values take 8 bytes in BigTIFF.
+		size_t word = m_big ? 8 : 4;
+		size_t count_size = m_big ? 8 : 2;
+		size_t entry_size = 4 + 2 * word;
+		size_t ifd_size = count_size + entries.size() * entry_size + word;
+		uint64_t start = m_end;
+
+		std::vector<uint8_t> ifd(ifd_size);
+		std::vector<uint8_t> values;
+		storeLittleEndian(ifd.data(), entries.size(), count_size);
+		uint8_t* entry = ifd.data() + count_size;
+		for (const IfdEntry& e : entries) {
+			storeLittleEndian(entry, e.tag, 2);
+			storeLittleEndian(entry + 2, e.type, 2);
+			storeLittleEndian(entry + 4, e.count, word);
+			uint8_t* value = entry + 4 + word;
+			if (e.data.size() <= word) {
+				memcpy(value, e.data.data(), e.data.size());
+			}
+			else {
+				storeLittleEndian(value, start + ifd_size + values.size(), word);
+				values.insert(values.end(), e.data.begin(), e.data.end());
+				if (values.size() % 2) values.push_back(0);
+			}
+			entry += entry_size;
+		}
+		uint64_t next = last ? 0 : start + ifd_size + values.size();
+		storeLittleEndian(entry, next, word);
+		append(ifd.data(), ifd.size());
+		append(values.data(), values.size());
+	}
+
+	FILE* m_file;
+	bool m_big;
+	std::mutex m_mutex;
+	uint64_t m_end = 0;
+	bool m_ok = true;
+};
+
+std::vector<Level> pyramid(size_t width, size_t height, const TiffOptions& options) {
+	std::vector<Level> levels;
+	size_t tile = options.tile_size;
+	while (true) {
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.tiles_w = 1 + (width - 1) / tile;
+		level.tiles_h = 1 + (height - 1) / tile;
+		level.tiles.resize(level.tiles_w * level.tiles_h);
+		level.band.resize(tile * width);
+		levels.push_back(std::move(level));
+		if (!options.overviews || (width <= tile && height <= tile)) return levels;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+// Whether the file could pass 4 GB and so has to be BigTIFF. Deflate
+// output is bounded by about the input size plus a little.
+bool needsBigTiff(const std::vector<Level>& levels, size_t tile_size) {
+	uint64_t tile_bytes = (uint64_t)tile_size * tile_size * sizeof(float);
+	uint64_t bound = 1 << 16;
+	for (const Level& level : levels) {
+		bound += level.tiles.size() * (tile_bytes + tile_bytes / 1000 + 64);
+	}
+	return bound > UINT32_MAX;
+}
+
+#ifdef WG_HAVE_ZLIB
+
+// Applies the TIFF floating-point predictor to one row of samples into
+// out: the bytes are split into planes, most significant first, and each
+// byte is replaced by its difference to the one before. Neighbouring
+// heights share their high bytes, which then deflate to almost nothing.
+void predictRow(const float* row, size_t n, uint8_t* out) {
+	const uint8_t* bytes = (const uint8_t*)row;
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t b = 0; b < sizeof(float); b++)
+		{
+			out[(sizeof(float) - 1 - b) * n + i] = bytes[i * sizeof(float) + b];
+		}
+	}
+	for (size_t i = n * sizeof(float) - 1; i > 0; i--)
+	{
+		out[i] = (uint8_t)(out[i] - out[i - 1]);
+	}
+}
+
+#endif
+
+class TiffPyramid {
+public:
+	TiffPyramid(TiffFile& file, std::vector<Level>& levels, size_t tile_size, bool deflate, ThreadPool& pool)
+		: m_file(file), m_levels(levels), m_tile_size(tile_size), m_deflate(deflate), m_pool(pool) {}
+
+	// Pads tile tx of the band of level to a whole tile, deflates it if
+	// asked and appends it to the file.
+	void writeTile(Level& level, size_t tx) {
+		size_t x0 = tx * m_tile_size;
+		size_t w = std::min(m_tile_size, level.width - x0);
+		std::vector<float> tile(m_tile_size * m_tile_size, 0.f);
+		for (size_t y = 0; y < level.band_rows; y++)
+		{
+			const float* row = level.band.data() + y * level.width + x0;
+			std::copy(row, row + w, tile.data() + y * m_tile_size);
+		}
+		const uint8_t* data = (const uint8_t*)tile.data();
+		size_t size = tile.size() * sizeof(float);
+#ifdef WG_HAVE_ZLIB
+		std::vector<uint8_t> predicted;
+		std::vector<uint8_t> deflated;
+		if (m_deflate) {
+			predicted.resize(size);
+			size_t row_bytes = m_tile_size * sizeof(float);
+			for (size_t y = 0; y < m_tile_size; y++)
+			{
+				predictRow(tile.data() + y * m_tile_size, m_tile_size, predicted.data() + y * row_bytes);
+			}
+			// The fastest level, like PNG export: most of the gain is
+			// from the predictor.
+			uLongf deflated_size = compressBound((uLong)size);
+			deflated.resize(deflated_size);
+			if (compress2(deflated.data(), &deflated_size, predicted.data(), (uLong)size, Z_BEST_SPEED) != Z_OK) {
+				m_file.fail();
+				return;
+			}
+			data = deflated.data();
+			size = deflated_size;
+		}
+#endif
+		size_t ty = level.band_y / m_tile_size;
+		level.tiles[ty * level.tiles_w + tx] = { m_file.append(data, size), size };
+	}
+
+	// Call once the band of level k is complete and, for level 0, its
+	// tiles written. Writes the tiles of overview bands and halves the band
+	// into the next level, finishing that band too once it is full.
+	void bandDone(size_t k) {
+		Level& level = m_levels[k];
+		if (k > 0) {
+			m_pool.parallelFor(level.tiles_w, [&](size_t tx) {
+				writeTile(level, tx);
+				});
+		}
+		if (k + 1 < m_levels.size()) {
+			Level& next = m_levels[k + 1];
+			size_t rows = (level.band_rows + 1) / 2;
+			m_pool.parallelFor(rows, [&](size_t y) {
+				downsampleRow(level, y, next.band.data() + (next.band_rows + y) * next.width);
+				});
+			next.band_rows += rows;
+			if (next.band_rows == m_tile_size || next.band_y + next.band_rows == next.height) bandDone(k + 1);
+		}
+		level.band_y += level.band_rows;
+		level.band_rows = 0;
+	}
+
+private:
+	// Averages the 2x2 blocks of band rows 2y and 2y + 1 into out. Blocks
+	// hanging over the right or bottom edge of the level use its last
+	// column or row twice.
+	void downsampleRow(const Level& level, size_t y, float* out) {
+		const float* top = level.band.data() + 2 * y * level.width;
+		const float* bottom = 2 * y + 1 < level.band_rows ? top + level.width : top;
+		size_t out_w = (level.width + 1) / 2;
+		for (size_t x = 0; x < out_w; x++)
+		{
+			size_t x1 = std::min(2 * x + 1, level.width - 1);
+			out[x] = (top[2 * x] + top[x1] + bottom[2 * x] + bottom[x1]) * 0.25f;
+		}
+	}
+
+	TiffFile& m_file;
+	std::vector<Level>& m_levels;
+	size_t m_tile_size;
+	bool m_deflate;
+	ThreadPool& m_pool;
+};
+
+bool writeTiff(const std::string& path, size_t width, size_t height, const TiffOptions& options, ThreadPool& pool, const FillRect& fill, GenerationProgress* progress, const CancellationToken* cancel) {
+	size_t tile = options.tile_size;
+	if (tile == 0 || tile % 16 != 0 || width == 0 || height == 0 || width > UINT32_MAX || height > UINT32_MAX) return false;
+#ifdef WG_HAVE_ZLIB
+	bool deflate = options.deflate;
+#else
+	bool deflate = false;
+#endif
+	std::vector<Level> levels = pyramid(width, height, options);
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+	TiffFile out(file, options.big_tiff || needsBigTiff(levels, tile));
+	TiffPyramid tiff(out, levels, tile, deflate, pool);
+	if (progress) {
+		progress->done = 0;
+		progress->total = levels[0].tiles.size();
+	}
+
+	Level& full = levels[0];
+	bool ok = true;
+	for (size_t y = 0; y < height && ok; y += tile)
+	{
+		full.band_rows = std::min(tile, height - y);
+		// Every worker generates, deflates and appends its own tiles, so
+		// tiles land in the file in the order they finish.
+		pool.parallelFor(full.tiles_w, [&](size_t tx) {
+			if (cancel && cancel->cancelled()) return;
+			size_t x0 = tx * tile;
+			fill(full.band.data() + x0, width, x0, y, std::min(tile, width - x0), full.band_rows);
+			tiff.writeTile(full, tx);
+			if (progress) progress->done++;
+			});
+		ok = !(cancel && cancel->cancelled()) && out.ok();
+		if (ok) tiff.bandDone(0);
+	}
+	if (ok) out.writeDirectories(levels, tile, deflate);
+	ok = ok && out.ok();
+	return fclose(file) == 0 && ok;
+}
+
+}
+
+bool writeTiledTiff(const std::string& path, const float* map, size_t width, size_t height, const TiffOptions& options, ThreadPool& pool) {
+	auto fill = [&](float* out, size_t stride, size_t x0, size_t y0, size_t w, size_t h) {
+		for (size_t y = 0; y < h; y++)
+		{
+			const float* row = map + (y0 + y) * width + x0;
+			std::copy(row, row + w, out + y * stride);
+		}
+	};
+	return writeTiff(path, width, height, options, pool, fill, nullptr, nullptr);
+}
+
+bool generateTiledTiff(const std::string& path, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, const TiffOptions& options, ThreadPool& pool, GenerationProgress* progress, const CancellationToken* cancel) {
+	std::vector<Octave> layers;
+	if (!mapOctaves(layers, width, height, octaves, persistence, lacunarity, seed, source, noise, cancel)) return false;
+	auto fill = [&](float* out, size_t stride, size_t x0, size_t y0, size_t w, size_t h) {
+		sampleRect(out, stride, x0, y0, w, h, layers);
+	};
+	return writeTiff(path, width, height, options, pool, fill, progress, cancel);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "generator.h"
+
+#include <cstddef>
+#include <string>
+
+struct TiffOptions {
+	// Width and height of every tile. TIFF wants a multiple of 16.
+	size_t tile_size = 256;
+	// Deflates tiles on the pool's workers. Builds without zlib
+	// (WG_HAVE_ZLIB) write uncompressed tiles instead.
+	bool deflate = true;
+	// Appends reduced-resolution levels, each half the size of the one
+	// before, until a level fits into one tile.
+	bool overviews = true;
+	// Writes BigTIFF even when the file can't pass 4 GB.
+	bool big_tiff = false;
+};
+
+// Writes a width x height map as a tiled float32 GeoTIFF. Georeferencing is
+// in pixels with no coordinate system: pixel (0, 0) is at model (0, 0), one
+// unit per pixel. Overview levels are box-filtered 2x2 from the level above
+// and stored in the same file after the full-resolution image. The file is
+// BigTIFF if asked or if it could pass 4 GB, classic TIFF otherwise. Tiles are
+// written in the order they finish, with the directories at the end of the
+// file; readers fetch any region tile by tile either way. Returns false if
+// options are invalid or writing failed.
+bool writeTiledTiff(const std::string& path, const float* map, size_t width, size_t height, const TiffOptions& options, ThreadPool& pool);
+
+// Generates the map generateMap would produce and writes it as
+// writeTiledTiff does, without ever holding all of it. Each worker
+// generates a tile, deflates it and appends it to the file, one band of
+// tiles at a time, so only a band per level has to fit in memory. Use
+// hashed gradients for maps larger than memory. progress counts
+// full-resolution tiles. Returns false if cancelled or writing failed.
+bool generateTiledTiff(const std::string& path, size_t width, size_t height, size_t octaves, float persistence, float lacunarity, uint32_t seed, GradientSource source, NoiseBackend noise, const TiffOptions& options, ThreadPool& pool, GenerationProgress* progress = nullptr, const CancellationToken* cancel = nullptr);
@@ -0,0 +1,76 @@
+#include "tile_cache.h"
+
+namespace {
+
+const size_t TILE_BYTES = CHUNK_SIZE * CHUNK_SIZE * sizeof(float);
+
+}
+
+TileCache::TileCache(size_t budget_bytes) : m_budget(budget_bytes) {
+}
+
+void TileCache::setWorld(std::shared_ptr<const World> world) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_world = std::move(world);
+	m_lru.clear();
+	m_index.clear();
+}
+
+std::shared_ptr<const Tile> TileCache::tile(int64_t cx, int64_t cy, unsigned lod, ThreadPool& pool, const CancellationToken* cancel) {
+	TileKey key{ cx, cy, lod };
+	std::shared_ptr<const World> world;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_world) return nullptr;
+		auto it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_stats.hits++;
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			return it->second->tile;
+		}
+		m_stats.misses++;
+		world = m_world;
+	}
+
+	auto tile = std::make_shared<Tile>(CHUNK_SIZE * CHUNK_SIZE);
+	if (!world->generateTile(tile->data(), cx, cy, lod, pool, cancel)) return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (world != m_world) return tile;
+	// Another thread may have generated the same tile meanwhile.
+	auto it = m_index.find(key);
+	if (it != m_index.end()) return it->second->tile;
+	m_lru.push_front({ key, tile });
+	m_index[key] = m_lru.begin();
+	evictOverBudget();
+	return tile;
+}
+
+std::shared_ptr<const Tile> TileCache::peek(int64_t cx, int64_t cy, unsigned lod) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_index.find(TileKey{ cx, cy, lod });
+	return it == m_index.end() ? nullptr : it->second->tile;
+}
+
+void TileCache::setBudget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = bytes;
+	evictOverBudget();
+}
+
+TileCacheStats TileCache::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TileCacheStats stats = m_stats;
+	stats.tiles = m_lru.size();
+	stats.bytes = m_lru.size() * TILE_BYTES;
+	stats.budget = m_budget;
+	return stats;
+}
+
+void TileCache::evictOverBudget() {
+	while (!m_lru.empty() && m_lru.size() * TILE_BYTES > m_budget) {
+		m_index.erase(m_lru.back().key);
+		m_lru.pop_back();
+		m_stats.evictions++;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "world.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// CHUNK_SIZE x CHUNK_SIZE heights of one world tile.
+typedef std::vector<float> Tile;
+
+// 256 MB, or 1024 tiles.
+const size_t DEFAULT_TILE_CACHE_BYTES = 256 << 20;
+
+struct TileCacheStats {
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	size_t tiles = 0;
+	size_t bytes = 0;
+	size_t budget = 0;
+};
+
+// Tiles of one World, kept up to a byte budget and dropped least recently
+// used first. Safe to use from several threads; tiles are generated
+// outside the lock, and a tile handed out stays valid after eviction.
+class TileCache {
+public:
+	explicit TileCache(size_t budget_bytes = DEFAULT_TILE_CACHE_BYTES);
+
+	// Drops every tile and serves tiles of world from now on. Tiles of the
+	// previous world that are still being generated are not cached.
+	void setWorld(std::shared_ptr<const World> world);
+
+	// Returns the tile, generating it on a miss. Returns null if there is no
+	// world or the generation was cancelled.
+	std::shared_ptr<const Tile> tile(int64_t cx, int64_t cy, unsigned lod, ThreadPool& pool, const CancellationToken* cancel = nullptr);
+
+	// Returns the tile if it is cached, without generating it or touching the
+	// statistics.
+	std::shared_ptr<const Tile> peek(int64_t cx, int64_t cy, unsigned lod) const;
+
+	// Evicts right away if the new budget is smaller.
+	void setBudget(size_t bytes);
+
+	TileCacheStats stats() const;
+
+private:
+	struct Entry {
+		TileKey key;
+		std::shared_ptr<const Tile> tile;
+	};
+
+	// Callers hold m_mutex.
+	void evictOverBudget();
+
+	mutable std::mutex m_mutex;
+	std::shared_ptr<const World> m_world;
+	// Most recently used first.
+	std::list<Entry> m_lru;
+	std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> m_index;
+	size_t m_budget;
+	TileCacheStats m_stats;
+};
@@ -0,0 +1,146 @@
+#include "tile_streamer.h"
+#include "colorize.h"
+
+#include <algorithm>
+#include <cmath>
+
+unsigned lodForZoom(double zoom) {
+	if (zoom >= 1) return 0;
+	return std::min(MAX_LOD, (unsigned)std::floor(std::log2(1 / zoom)));
+}
+
+int64_t coarserTile(int64_t c, unsigned d) {
+	int64_t n = (int64_t)1 << d;
+	return c >= 0 ? c / n : -((-c + n - 1) / n);
+}
+
+std::vector<TileKey> tilesToStream(const Viewport& view, unsigned lod, int64_t margin) {
+	double extent = (double)World::tileExtent(lod);
+	int64_t x0 = (int64_t)std::floor(view.x / extent) - margin;
+	int64_t y0 = (int64_t)std::floor(view.y / extent) - margin;
+	int64_t x1 = (int64_t)std::floor((view.x + view.width) / extent) + margin;
+	int64_t y1 = (int64_t)std::floor((view.y + view.height) / extent) + margin;
+
+	std::vector<TileKey> tiles;
+	for (int64_t cy = y0; cy <= y1; cy++)
+	{
+		for (int64_t cx = x0; cx <= x1; cx++)
+		{
+			tiles.push_back({ cx, cy, lod });
+		}
+	}
+	double mid_x = view.x + view.width / 2;
+	double mid_y = view.y + view.height / 2;
+	auto distance = [&](const TileKey& key) {
+		double dx = (key.cx + 0.5) * extent - mid_x;
+		double dy = (key.cy + 0.5) * extent - mid_y;
+		return dx * dx + dy * dy;
+	};
+	std::sort(tiles.begin(), tiles.end(), [&](const TileKey& a, const TileKey& b) { return distance(a) < distance(b); });
+	return tiles;
+}
+
+TileStreamer::TileStreamer(TileCache& cache, ThreadPool& pool) : m_cache(cache), m_pool(pool) {
+	m_worker = std::thread(&TileStreamer::workerLoop, this);
+}
+
+TileStreamer::~TileStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	m_worker.join();
+}
+
+void TileStreamer::request(std::vector<TileKey> tiles) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.assign(tiles.begin(), tiles.end());
+	}
+	m_cv.notify_all();
+}
+
+void TileStreamer::reset() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queue.clear();
+	m_ready.clear();
+	m_epoch++;
+	m_cancel.cancel();
+}
+
+void TileStreamer::setColormap(std::shared_ptr<const Colormap> colormap) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_colormap = std::move(colormap);
+}
+
+std::vector<TileStreamer::Ready> TileStreamer::takeReady(size_t max) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Ready> ready;
+	while (!m_ready.empty() && ready.size() < max) {
+		ready.push_back(std::move(m_ready.front()));
+		m_ready.pop_front();
+	}
+	return ready;
+}
+
+size_t TileStreamer::pending() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queue.size() + (m_working ? 1 : 0);
+}
+
+void TileStreamer::workerLoop() {
+	while (true) {
+		TileKey key;
+		size_t epoch;
+		std::shared_ptr<const Colormap> colormap;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+			if (m_stop) return;
+			key = m_queue.front();
+			m_queue.pop_front();
+			epoch = m_epoch;
+			colormap = m_colormap;
+			m_working = true;
+			m_cancel.reset();
+		}
+
+		std::shared_ptr<const Tile> tile = m_cache.tile(key.cx, key.cy, key.lod, m_pool, &m_cancel);
+		Ready ready{ key, std::vector<uint8_t>(CHUNK_SIZE * CHUNK_SIZE * 4) };
+		if (tile) mapToPixels(tile->data(), CHUNK_SIZE, CHUNK_SIZE, ready.pixels.data(), CHUNK_SIZE, colormap.get());
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_working = false;
+		if (tile && epoch == m_epoch) m_ready.push_back(std::move(ready));
+	}
+}
+
+TileAtlas::TileAtlas(size_t slots_w, size_t slots_h) : m_slots_w(slots_w), m_slots(slots_w * slots_h) {
+}
+
+bool TileAtlas::find(const TileKey& key, size_t& slot) {
+	auto it = m_index.find(key);
+	if (it == m_index.end()) return false;
+	slot = it->second;
+	m_slots[slot].last_used = ++m_clock;
+	return true;
+}
+
+size_t TileAtlas::insert(const TileKey& key) {
+	size_t slot;
+	if (find(key, slot)) return slot;
+	auto oldest = std::min_element(m_slots.begin(), m_slots.end(), [](const Slot& a, const Slot& b) {
+		return a.last_used < b.last_used;
+		});
+	slot = oldest - m_slots.begin();
+	if (oldest->used) m_index.erase(oldest->key);
+	*oldest = { key, true, ++m_clock };
+	m_index[key] = slot;
+	return slot;
+}
+
+void TileAtlas::clear() {
+	std::fill(m_slots.begin(), m_slots.end(), Slot());
+	m_index.clear();
+}
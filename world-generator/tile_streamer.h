@@ -0,0 +1,120 @@
+#pragma once
+
+#include "colormap.h"
+#include "tile_cache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Coarsest level of detail the viewer streams.
+const unsigned MAX_LOD = 16;
+
+// Part of the world on screen, in world pixels. zoom is screen pixels per
+// world pixel.
+struct Viewport {
+	double x;
+	double y;
+	double width;
+	double height;
+	double zoom;
+};
+
+// Coarsest level of detail whose samples are at most one screen pixel
+// apart at this zoom.
+unsigned lodForZoom(double zoom);
+
+// Tiles at lod that overlap the viewport, plus margin rings of tiles around
+// it to prefetch, nearest to the viewport centre first.
+std::vector<TileKey> tilesToStream(const Viewport& view, unsigned lod, int64_t margin);
+
+// Tile coordinate d levels of detail coarser, rounding down.
+int64_t coarserTile(int64_t c, unsigned d);
+
+// Generates and colorizes tiles on its own thread in the order they were
+// requested, so the closest tiles are ready first.
+class TileStreamer {
+public:
+	struct Ready {
+		TileKey key;
+		// CHUNK_SIZE x CHUNK_SIZE RGBA pixels.
+		std::vector<uint8_t> pixels;
+	};
+
+	TileStreamer(TileCache& cache, ThreadPool& pool);
+	~TileStreamer();
+
+	TileStreamer(const TileStreamer&) = delete;
+	TileStreamer& operator=(const TileStreamer&) = delete;
+
+	// Replaces the tiles still waiting with tiles, highest priority first.
+	void request(std::vector<TileKey> tiles);
+
+	// Drops waiting and ready tiles and cancels the one being generated. Call
+	// after the cache switched worlds.
+	void reset();
+
+	// Colors tiles through colormap from now on, or as grayscale if it is
+	// null. Call reset too to drop tiles colored the old way.
+	void setColormap(std::shared_ptr<const Colormap> colormap);
+
+	// Up to max tiles finished since the last call, in the order they
+	// finished.
+	std::vector<Ready> takeReady(size_t max);
+
+	// Tiles requested but not finished yet.
+	size_t pending() const;
+
+private:
+	void workerLoop();
+
+	TileCache& m_cache;
+	ThreadPool& m_pool;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_stop = false;
+	std::deque<TileKey> m_queue;
+	std::deque<Ready> m_ready;
+	std::shared_ptr<const Colormap> m_colormap;
+	// Bumped by reset so tiles of an older world are thrown away.
+	size_t m_epoch = 0;
+	// Cancelled by reset to stop the tile being generated.
+	CancellationToken m_cancel;
+	bool m_working = false;
+	std::thread m_worker;
+};
+
+// Assigns tiles to the CHUNK_SIZE square slots of a texture atlas, reusing
+// the least recently used slot when all are taken. Holds no pixels itself.
+class TileAtlas {
+public:
+	TileAtlas(size_t slots_w, size_t slots_h);
+
+	// Looks up the slot holding key and marks it used.
+	bool find(const TileKey& key, size_t& slot);
+
+	// Slot to upload key into.
+	size_t insert(const TileKey& key);
+
+	void clear();
+
+	// Texel position of a slot's top-left corner.
+	size_t slotX(size_t slot) const { return slot % m_slots_w * CHUNK_SIZE; }
+	size_t slotY(size_t slot) const { return slot / m_slots_w * CHUNK_SIZE; }
+
+private:
+	struct Slot {
+		TileKey key;
+		bool used = false;
+		size_t last_used = 0;
+	};
+
+	size_t m_slots_w;
+	std::vector<Slot> m_slots;
+	std::unordered_map<TileKey, size_t, TileKeyHash> m_index;
+	size_t m_clock = 0;
+};
@@ -0,0 +1,39 @@
+#include "world.h"
+
+#include <algorithm>
+
+size_t TileKeyHash::operator()(const TileKey& key) const {
+	uint64_t h = (uint64_t)key.cx * 0x9E3779B97F4A7C15ull;
+	h ^= (uint64_t)key.cy * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+	h ^= (uint64_t)key.lod * 0xD6E8FEB86659FD93ull + (h >> 31);
+	return (size_t)(h ^ (h >> 32));
+}
+
+World::World(size_t octaves, float persistence, float lacunarity, uint32_t seed, NoiseBackend noise, size_t scale) {
+	for (const OctaveSpec& spec : octaveSpecs(scale, octaves, persistence, lacunarity, seed)) {
+		m_layers.push_back({ GradientField(GradientSource::Hash, spec.seed), spec.grid_cell_size, spec.amplitude, &noiseBackend(noise) });
+	}
+}
+
+bool World::generateTile(float* out, int64_t cx, int64_t cy, unsigned lod, ThreadPool& pool, const CancellationToken* cancel) const {
+	size_t step = (size_t)1 << lod;
+	int64_t x0 = cx * tileExtent(lod);
+	int64_t y0 = cy * tileExtent(lod);
+
+	// Same fused sum as generateMap, one tile row per index.
+	SimdLevel level = detectSimdLevel();
+	pool.parallelFor(CHUNK_SIZE, [&](size_t j) {
+		if (cancel && cancel->cancelled()) return;
+		float value[CHUNK_SIZE];
+		float* row = out + j * CHUNK_SIZE;
+		std::fill(row, row + CHUNK_SIZE, 0.f);
+		for (const Octave& octave : m_layers) {
+			octave_process_rect(value, CHUNK_SIZE, octave, x0, y0 + (int64_t)(j * step), CHUNK_SIZE, 1, level, step);
+			for (size_t i = 0; i < CHUNK_SIZE; i++)
+			{
+				row[i] += value[i] * octave.amplitude;
+			}
+		}
+		});
+	return !(cancel && cancel->cancelled());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "generator.h"
+
+#include <vector>
+
+// Edge length in samples of a world tile.
+const size_t CHUNK_SIZE = 256;
+
+// Tile (cx, cy) at level of detail lod.
+struct TileKey {
+	int64_t cx;
+	int64_t cy;
+	unsigned lod;
+
+	bool operator==(const TileKey& other) const { return cx == other.cx && cy == other.cy && lod == other.lod; }
+};
+
+struct TileKeyHash {
+	size_t operator()(const TileKey& key) const;
+};
+
+// Unbounded map made of tiles that are generated on demand. Gradients are
+// hashed from the lattice coordinates, so any tile can be generated on its
+// own and neighbouring tiles join without seams. The octaves are those of
+// generateMap for a map scale pixels wide, and the part of the world at
+// [0, scale) x [0, height) equals generateMap with hashed gradients and the
+// same backend.
+class World {
+public:
+	World(size_t octaves, float persistence, float lacunarity, uint32_t seed, NoiseBackend noise, size_t scale);
+
+	// Edge length in world pixels of a tile at level of detail lod.
+	static int64_t tileExtent(unsigned lod) { return (int64_t)CHUNK_SIZE << lod; }
+
+	// Writes the CHUNK_SIZE x CHUNK_SIZE samples of tile (cx, cy) at level of
+	// detail lod to out. Samples are 2^lod pixels apart starting at world
+	// pixel (cx, cy) * tileExtent(lod), so a tile at lod holds every 2^lod-th
+	// sample of the lod 0 tiles it covers. Returns false if cancelled.
+	bool generateTile(float* out, int64_t cx, int64_t cy, unsigned lod, ThreadPool& pool, const CancellationToken* cancel = nullptr) const;
+
+private:
+	std::vector<Octave> m_layers;
+};
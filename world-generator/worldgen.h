@@ -0,0 +1,27 @@
+#pragma once
+
+// Public interface of the worldgen library. Free of SFML and any windowing
+// code, so batch tools can link it on their own.
+
+#include "background_generator.h"
+#include "colorize.h"
+#include "colormap.h"
+#include "compact_heightfield.h"
+#include "dirty_rect.h"
+#include "generator.h"
+#include "gradients.h"
+#include "heightmap_io.h"
+#include "hillshade.h"
+#include "map_exporter.h"
+#include "mapped_file.h"
+#include "mapped_heightmap.h"
+#include "octave_cache.h"
+#include "parse_args.h"
+#include "png_writer.h"
+#include "progressive.h"
+#include "simplex.h"
+#include "thread_pool.h"
+#include "tiff_writer.h"
+#include "tile_cache.h"
+#include "tile_streamer.h"
+#include "world.h"